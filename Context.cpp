@@ -46,6 +46,9 @@ void Context::createDepthBuffer()
     {
         depth.first = static_cast<uint16_t*>(heap_caps_malloc(width * height * sizeof(uint16_t), MALLOC_CAP_SPIRAM));
         depth.second = static_cast<uint16_t*>(heap_caps_malloc(width * height * sizeof(uint16_t), MALLOC_CAP_SPIRAM));
+        //nothing is known about what the new buffers hold
+        depthMax.first.clear();
+        depthMax.second.clear();
     }
 }
 
@@ -55,6 +58,8 @@ void Context::createStencilBuffer()
     {
         stencil.first = static_cast<uint8_t*>(heap_caps_malloc(width * height * sizeof(uint8_t), MALLOC_CAP_SPIRAM));
         stencil.second = static_cast<uint8_t*>(heap_caps_malloc(width * height * sizeof(uint8_t), MALLOC_CAP_SPIRAM));
+        stencilMask.first = StencilMask();
+        stencilMask.second = StencilMask();
     }
 }
 
@@ -71,4 +76,6 @@ void Context::initViewport()
 {
     glViewportHeight = height;
     glViewportWidth = width;
+    glScissorHeight = height;
+    glScissorWidth = width;
 }
@@ -31,10 +31,41 @@ struct Context
         struct Luminance { uint8_t a; };
         struct LuminanceAlpha { uint8_t a; };
         struct Alpha { uint8_t a; };
+        //texel layout in data, from the format and type given to glTexImage2D, 16 bit ones in native byte order
+        enum Storage : uint8_t
+        {
+            RGBA8888,
+            RGB888,
+            RGB565,
+            RGBA4444,
+            RGBA5551,
+            Alpha8,
+            Luminance8,
+            LuminanceAlpha88,
+            //compressed, data as given to glCompressedTexImage2D, 4 or 8 bit indices into palette or ETC1 blocks
+            Palette4,
+            Palette8,
+            ETC1
+        };
         void* data = nullptr;
         uint16_t width;
         uint16_t height;
         uint16_t internalformat;
+        Storage storage = RGBA8888;
+        //GL_TEXTURE_TILED_ESP, texels kept in square blocks of consecutive memory, blocks in rows, padded to whole blocks
+        bool tiled = false;
+        //GL_TEXTURE_STORAGE_TYPE_ESP, the packed type GL_UNSIGNED_BYTE uploads are converted to
+        uint16_t storageType = GL_UNSIGNED_BYTE;
+        //Palette4 and Palette8 entries widened to RGBA8888, owned by level 0 and shared by the mipmaps
+        uint32_t* palette = nullptr;
+        //GL_TEXTURE_CROP_RECT_OES, u, v, width and height in texels
+        GLint cropRect[4] = { 0, 0, 0, 0 };
+        //GL_GENERATE_MIPMAP, rebuild the mipmaps whenever level 0 changes
+        bool generateMipmap = false;
+        //levels 1 and up, each half the size of the one before, data of a level not specified yet is nullptr
+        std::vector<Texture> mipmaps;
+        //a glTexImage2DAsyncESP upload is still writing some level, the texture is not sampled
+        bool uploading = false;
     };
     struct TextureUnit
     {
@@ -49,6 +80,7 @@ struct Context
         uint16_t glTextureMagFilter = GL_LINEAR;
         uint16_t glTextureWrapS = GL_REPEAT;
         uint16_t glTextureWrapT = GL_REPEAT;
+        bool glCoordReplace = false;
 
         bool glUseTexCoordArray = false;
         uint8_t glTexCoordPointerSize = 4;
@@ -60,6 +92,17 @@ struct Context
     std::pair<uint16_t*, uint16_t*> depth;
     std::pair<uint8_t*, uint8_t*> stencil;
     std::pair<uint8_t*, uint8_t*> alpha;
+    //hierarchical z of each depth buffer kept by GLES.cpp, one entry per raster block, only ever an upper bound of the depths inside
+    std::pair<std::vector<uint16_t>, std::vector<uint16_t>> depthMax;
+    //what each stencil buffer holds, as far as glClear and the draws writing it tell: one screen aligned rectangle of
+    //value inside on a background of value outside, an empty rectangle if minX > maxX
+    struct StencilMask
+    {
+        bool known = false;
+        int16_t minX = 0, minY = 0, maxX = -1, maxY = -1;
+        uint8_t inside = 0, outside = 0;
+    };
+    std::pair<StencilMask, StencilMask> stencilMask;
     const Config* config;
 
     bool* surfaceFirstFrameBuffer = nullptr;
@@ -88,11 +131,17 @@ struct Context
     uint16_t glClientActiveTexture = 0;
 
     uint16_t glMatrixMode = GL_MODELVIEW;
-    uint16_t glViewportX = 0;
-    uint16_t glViewportY = 0;
+    int16_t glViewportX = 0;
+    int16_t glViewportY = 0;
     uint16_t glViewportWidth = 0;
     uint16_t glViewportHeight = 0;
 
+    bool glScissorTest = false;
+    int16_t glScissorX = 0;
+    int16_t glScissorY = 0;
+    uint16_t glScissorWidth = 0;
+    uint16_t glScissorHeight = 0;
+
     bool glUseVertexArray = false;
     uint8_t glVertexPointerSize = 4;
     uint16_t glVertexPointerType = GL_FLOAT;
@@ -124,6 +173,37 @@ struct Context
     uint16_t glAlphaFunc = GL_ALWAYS;
     GLfloat glAlphaRef = 0.f;
 
+    bool glDepthTest = false;
+    uint16_t glDepthFunc = GL_LESS;
+    bool glDepthMask = true;
+    GLfloat glDepthRangeNear = 0.f, glDepthRangeFar = 1.f;
+
+    GLfloat glPointSize = 1.f;
+    GLfloat glPointSizeMin = 0.f;
+    GLfloat glPointSizeMax = 256.f;
+    GLfloat glPointFadeThreshold = 1.f;
+    GLfloat glPointDistanceAttenuation[3] = { 1.f, 0.f, 0.f };
+    bool glPointSprite = false;
+    bool glUsePointSizeArray = false;
+    uint16_t glPointSizePointerType = GL_FLOAT;
+    uint32_t glPointSizePointerStride = 0;
+    const void* glPointSizePointer = nullptr;
+
+    bool glStencilTest = false;
+    uint16_t glStencilFunc = GL_ALWAYS;
+    uint8_t glStencilRef = 0;
+    uint8_t glStencilValueMask = 0xFF;
+    uint8_t glStencilWriteMask = 0xFF;
+    uint16_t glStencilFail = GL_KEEP;
+    uint16_t glStencilPassDepthFail = GL_KEEP;
+    uint16_t glStencilPassDepthPass = GL_KEEP;
+
+    uint8_t glPackAlignment = 4;
+    uint8_t glUnpackAlignment = 4;
+
+    bool glTileBinning = false;
+    bool glTexelCache = false;
+
     Context(const void* config);
 
     ~Context();
@@ -133,3 +213,5 @@ struct Context
     void createAlphaBuffer();
     void initViewport();
 };
+//frees what GLES.cpp keeps for the context between frames, called by eglDestroyContext before deleting it
+void releaseContextState(const Context* context);
\ No newline at end of file
@@ -184,7 +184,12 @@ EGLBoolean eglDestroyContext(EGLDisplay dpy, EGLContext ctx)
     }
     ABCv2_Display* display = static_cast<ABCv2_Display*>(dpy);
     if (display->context)
+    {
+        releaseContextState(display->context.get());
+        if (context == display->context.get())
+            context = nullptr;
         display->context.reset();
+    }
     lastError = EGL_BAD_CONTEXT;
     return EGL_FALSE;
 }
@@ -364,6 +369,9 @@ EGLBoolean eglMakeCurrent(EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLC
         ABCv2_Display* display = static_cast<ABCv2_Display*>(dpy);
         Context* con = display->context.get();
         Surface* sur = display->surface.get();
+        //binned triangles are drawn into the frame buffer of the context they were issued to
+        if (context)
+            glFlush();
         con->surfaceFirstFrameBuffer = &sur->firstFrameBuffer;
         sur->pixels = &con->pixels;
         sur->height = &con->height;
@@ -375,6 +383,8 @@ EGLBoolean eglMakeCurrent(EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLC
     {
         Context* con = static_cast<Context*>(ctx);
         Surface* sur = static_cast<Surface*>(read);
+        if (context)
+            glFlush();
         con->surfaceFirstFrameBuffer = &sur->firstFrameBuffer;
         sur->pixels = &con->pixels;
         sur->height = &con->height;
@@ -439,6 +449,8 @@ EGLBoolean eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
         return EGL_FALSE;
     }
     Surface* sur = (Surface*)surface;
+    //binned triangles have to reach the frame buffer before it is shown, texture uploads may go on streaming
+    glFlush();
     sur->swapBuffers();
     return EGL_TRUE;
 }
@@ -2,23 +2,50 @@
 
 #include <cfloat>
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 
 #include "Arduino.h"
 #include "Context.h"
+#include "Scheduler.h"
 
 #define LIBRARY_NAME "GLES1"
 #define glGetMaxTextureSize 512
+//log2 of glGetMaxTextureSize, the smallest mipmap of the largest texture
+#define glGetMaxTextureLevel 9
+#define glGetMaxPointSize 256
 #define glGetMaxModelViewStack 16
 #define glGetMaxProjectionStack 2
 #define glGetMaxTextureStack 2
 #define glGetMaxTextureUnits 2
+#define glGetMaxRasterWorkers 4
 
 #define oneDiv255 0.003921569f
 #define oneDiv256 0.00390625f
 #define degToRad 0.017453289f
 #define oneDiv65536 0.0000152587890625f
 
+//rasterizer works on fixed-point window coordinates with 4 fractional bits
+#define rasterSubpixelBits 4
+//furthest a vertex may be from the screen centre (in pixels) so edge values fit in int32
+#define rasterGuardBand 960.f
+//smallest w kept by the clipper, avoids dividing by zero
+#define clipMinW 0.00001f
+//fractional bits of the z interpolant below the 16 bit depth buffer, z steps of up to 128 depth ranges per pixel fit
+#define depthFractionBits 8
+//edge length of the screen tiles used by GL_TILE_BINNING_ESP
+#define tileSize 32
+//coarse coverage test granularity, tileSize has to be a multiple of it
+#define rasterBlockSize 8
+//log2 of the edge length of the texel blocks of GL_TEXTURE_TILED_ESP textures, 4x4 RGBA8888 texels fill 64 bytes
+#define textureTileShift 2
+//fractional bits of the normalized s and t interpolants, enough that a pixel step of 1 / width stays on the texel centres
+//of any texture width across the whole screen, the integer part wraps modulo 256, so GL_CLAMP_TO_EDGE coordinates outside
+//[-128, 128) or per pixel steps beyond that at extreme minification sample a wrapped texel instead of the edge
+#define texCoordShift 24
+//blocks of 1 << textureTileShift squared texels held by each GL_TEXEL_CACHE_ESP cache, a power of two
+#define texelCacheLines 64
+
 static GLint lastError = GL_NO_ERROR;
 
 Context* context;
@@ -31,10 +58,6 @@ namespace
         GLfloat col[4] = {0, 0, 0, 1};
         GLfloat tex[4] = {0, 0, 0, 1};
     };
-    struct Vector2
-    {
-        float x, y;
-    };
     uint16_t RGBto565(uint8_t r, uint8_t g, uint8_t b)
     {
         return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
@@ -83,308 +106,2754 @@ namespace
             return 2;
         case GL_SHORT:
             return 2;
+        case GL_FIXED:
+            return 4;
+        }
+        return 0;
+    }
+    void getVertexAtOffset(uint32_t vertexTotalOffset, uint32_t colorTotalOffset, uint32_t texCoordTotalOffset, Vertex* vertex)
+    {
+        const GLubyte* vertices = (const GLubyte*)context->glVertexPointer + vertexTotalOffset;
+        const GLubyte* colors = (const GLubyte*)context->glColorPointer + colorTotalOffset;
+        const GLubyte* texCoord = (const GLubyte*)context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointer + texCoordTotalOffset;
+
+        for (uint8_t j = 0; j < context->glVertexPointerSize; j++)
+        {
+            if (context->glVertexPointerType == GL_FLOAT)
+                vertex->pos[j] = ((GLfloat*)vertices)[j];
+            else if (context->glVertexPointerType == GL_SHORT)
+                vertex->pos[j] = ((GLshort*)vertices)[j];
+        }
+        if (context->glUseColorArray)
+            for (uint8_t j = 0; j < context->glColorPointerSize; j++)
+            {
+                if (context->glColorPointerType == GL_FLOAT)
+                    vertex->col[j] = ((GLfloat*)colors)[j];
+                else if (context->glColorPointerType == GL_SHORT)
+                    vertex->col[j] = ((GLshort*)colors)[j];
+                else if (context->glColorPointerType == GL_UNSIGNED_SHORT)
+                    vertex->col[j] = ((GLushort*)colors)[j];
+                else if (context->glColorPointerType == GL_BYTE)
+                    vertex->col[j] = ((GLbyte*)colors)[j];
+                else if (context->glColorPointerType == GL_UNSIGNED_BYTE)
+                    vertex->col[j] = ((GLubyte*)colors)[j] * oneDiv255;
+            }
+        if (context->glTextureUnit[context->glClientActiveTexture].glUseTexCoordArray)
+            for (uint8_t j = 0; j < context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointerSize; j++)
+            {
+                if (context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointerType == GL_FLOAT)
+                    vertex->tex[j] = ((GLfloat*)texCoord)[j];
+                else if (context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointerType == GL_SHORT)
+                    vertex->tex[j] = ((GLshort*)texCoord)[j];
+            }
+    }
+    float blendFactorCalc(GLenum factor, const float src[4], const float dst[4], uint8_t component)
+    {
+        switch (factor)
+        {
+        case GL_ZERO: return 0.f;
+        case GL_ONE: return 1.f;
+        case GL_SRC_COLOR: return src[component];
+        case GL_ONE_MINUS_SRC_COLOR: return 1.f - src[component];
+        case GL_DST_COLOR: return dst[component];
+        case GL_ONE_MINUS_DST_COLOR: return 1.f - dst[component];
+        case GL_SRC_ALPHA: return src[3];
+        case GL_ONE_MINUS_SRC_ALPHA: return 1.f - src[3];
+        case GL_DST_ALPHA: return dst[3];
+        case GL_ONE_MINUS_DST_ALPHA: return 1.f - dst[3];
+        case GL_SRC_ALPHA_SATURATE:
+            if (component == 3)
+                return 1.f;
+            return min(src[3], 1.f - dst[3]);
+        default:
+            return 1.f;
+        }
+    }
+    void vertexShader(Vertex& targetVertex, const std::array<float, 16>& mvpMatrix)
+    {
+        //Now transform
+        GLfloat temp[4];
+        // ESP_LOGE("Pos", "%f %f %f %f", targetVertex.pos[0], targetVertex.pos[1], targetVertex.pos[2], targetVertex.pos[3]);
+        multiplyMatrixVector(mvpMatrix, targetVertex.pos, temp);
+        //stays in clip space, drawTriangle divides by w after clipping
+        memcpy(targetVertex.pos, temp, 4 * sizeof(GLfloat));
+
+        multiplyMatrixVector(context->glTextureUnit[context->glActiveTexture].glTextureMatrix.back(), targetVertex.tex, temp);
+        memcpy(targetVertex.tex, temp, 4 * sizeof(GLfloat));
+    }
+
+    struct DrawState;
+    struct RenderTarget;
+    struct Interpolants;
+    struct TexelCache;
+    //shades count consecutive pixels of one row starting at iBuf
+    typedef void (*SpanKernel)(const DrawState& state, const RenderTarget& target, uint32_t iBuf, Interpolants in, const Interpolants& step, int32_t count);
+    //reads one filtered RGBA texel, one per storage, layout, filter and whether it reads through the texel cache
+    typedef void (*TexelSampler)(const DrawState& state, const Interpolants& in, TexelCache* cache, uint8_t src[4]);
+    //marks the textures of finished glTexImage2DAsyncESP uploads ready
+    void collectUploads();
+
+    //everything the fragment stage reads, captured once per draw call
+    struct DrawState
+    {
+        const Context::Texture* texture = nullptr;
+        //GL_LINEAR rather than GL_NEAREST sampling, the magnification filter until rasterize finds a setup minifies
+        bool textureLinear = false;
+        bool minifyLinear = false;
+        TexelSampler sampler = nullptr;
+        //GL_REPEAT rather than GL_CLAMP_TO_EDGE along s and t
+        bool repeatS = false;
+        bool repeatT = false;
+        //GL_TEXEL_CACHE_ESP, sampler fetches through RenderTarget::texelCache
+        bool texelCache = false;
+        bool useColorArray = false;
+        bool alphaTest = false;
+        uint16_t alphaFunc = GL_ALWAYS;
+        GLfloat alphaRef = 0.f;
+        uint8_t alphaRef8 = 0;
+        bool depthTest = false;
+        uint16_t depthFunc = GL_LESS;
+        bool depthWrite = false;
+        bool stencilTest = false;
+        uint16_t stencilFunc = GL_ALWAYS;
+        uint8_t stencilRef = 0;
+        uint8_t stencilValueMask = 0xFF;
+        uint8_t stencilWriteMask = 0xFF;
+        uint16_t stencilFail = GL_KEEP;
+        uint16_t stencilZFail = GL_KEEP;
+        uint16_t stencilZPass = GL_KEEP;
+        //some stencil value may change, false when every op is GL_KEEP or nothing is writable
+        bool stencilWrites = false;
+        //window rectangle the draw is limited to, viewport and scissor box narrowed by a rectangular stencil mask
+        int16_t clipMinX = 0, clipMinY = 0, clipMaxX = -1, clipMaxY = -1;
+        bool blend = false;
+        uint16_t blendColorSrc = GL_ONE;
+        uint16_t blendAlphaSrc = GL_ONE;
+        uint16_t blendColorDst = GL_ZERO;
+        uint16_t blendAlphaDst = GL_ZERO;
+        SpanKernel kernel = nullptr;
+        //kernel of minified setups, differs from kernel only in the filter
+        SpanKernel minifyKernel = nullptr;
+        //minified setups sample the mipmap level matching their texel to pixel ratio
+        bool mipmap = false;
+    };
+    //window rectangle a primitive may write to, either the whole frame buffer or one SRAM tile
+    struct RenderTarget
+    {
+        uint16_t* color;
+        uint8_t* alpha;
+        uint16_t* depth;
+        //farthest depth of every rasterBlockSize block of the whole frame, indexed in window coordinates
+        uint16_t* depthMax;
+        uint8_t* stencil;
+        //cache of the thread drawing into the target, nullptr without GL_TEXEL_CACHE_ESP
+        TexelCache* texelCache;
+        int32_t stride;
+        int16_t originX, originY;
+        int16_t minX, minY, maxX, maxY;
+    };
+    //decoded RGBA8888 texel blocks of recently sampled textures in internal RAM, one per thread drawing,
+    //direct mapped on the storage of the level and the block, the block layout of GL_TEXTURE_TILED_ESP for either layout
+    struct TexelCache
+    {
+        struct Tag
+        {
+            const void* data = nullptr;
+            uint32_t block = 0;
+        };
+        Tag tags[texelCacheLines];
+        uint32_t* texels = nullptr;
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+    };
+    std::vector<TexelCache> texelCaches;
+    TexelCache* workerTexelCache(uint8_t worker)
+    {
+        return worker < texelCaches.size() && texelCaches[worker].texels ? &texelCaches[worker] : nullptr;
+    }
+    //a thread without internal RAM for its cache samples uncached
+    void initTexelCaches(uint8_t workers)
+    {
+        if (texelCaches.size() < workers)
+            texelCaches.resize(workers);
+        for (TexelCache& cache : texelCaches)
+            if (!cache.texels)
+            {
+                cache.texels = static_cast<uint32_t*>(heap_caps_malloc(texelCacheLines * (4 << (2 * textureTileShift)), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+                if (!cache.texels)
+                    ESP_LOGE(LIBRARY_NAME, "No internal RAM for the texel cache, textures are sampled from their storage");
+            }
+    }
+    //every texture write goes through here, none runs while the bins are resolved
+    void invalidateTexelCaches()
+    {
+        for (TexelCache& cache : texelCaches)
+            for (TexelCache::Tag& tag : cache.tags)
+                tag.data = nullptr;
+    }
+    uint16_t depthMaxStride()
+    {
+        return (context->width + rasterBlockSize - 1) / rasterBlockSize;
+    }
+    uint32_t depthMaxSize()
+    {
+        return depthMaxStride() * ((context->height + rasterBlockSize - 1) / rasterBlockSize);
+    }
+    //the hierarchical z of the depth buffer drawn into, nothing is known about a surface that changed size
+    uint16_t* currentDepthMax()
+    {
+        std::vector<uint16_t>& bounds = *context->surfaceFirstFrameBuffer ? context->depthMax.first : context->depthMax.second;
+        if (bounds.size() != depthMaxSize())
+            bounds.assign(depthMaxSize(), 0xFFFF);
+        return bounds.data();
+    }
+    //the scissor box with window rows counted from the top, clamped to the frame buffer and empty if min > max
+    void scissorRect(int16_t& minX, int16_t& minY, int16_t& maxX, int16_t& maxY)
+    {
+        minX = 0;
+        minY = 0;
+        maxX = context->width - 1;
+        maxY = context->height - 1;
+        if (!context->glScissorTest)
+            return;
+        minX = max<int32_t>(minX, context->glScissorX);
+        maxX = min<int32_t>(maxX, context->glScissorX + context->glScissorWidth - 1);
+        minY = max<int32_t>(minY, context->height - context->glScissorY - context->glScissorHeight);
+        maxY = min<int32_t>(maxY, context->height - 1 - context->glScissorY);
+    }
+    RenderTarget frameRenderTarget()
+    {
+        RenderTarget target;
+        target.color = *context->surfaceFirstFrameBuffer ? context->pixels.first : context->pixels.second;
+        target.alpha = *context->surfaceFirstFrameBuffer ? context->alpha.first : context->alpha.second;
+        target.depth = *context->surfaceFirstFrameBuffer ? context->depth.first : context->depth.second;
+        target.depthMax = target.depth ? currentDepthMax() : nullptr;
+        target.stencil = *context->surfaceFirstFrameBuffer ? context->stencil.first : context->stencil.second;
+        target.texelCache = workerTexelCache(0);
+        target.stride = context->width;
+        target.originX = 0;
+        target.originY = 0;
+        target.minX = 0;
+        target.minY = 0;
+        target.maxX = context->width - 1;
+        target.maxY = context->height - 1;
+        return target;
+    }
+
+    //attribute values at a pixel centre, texture coordinates in 8.24, colors in 8.16 and window z in 16.8 fixed point
+    struct Interpolants
+    {
+        //texCoordShift fractional bits
+        int32_t s, t;
+        int32_t r, g, b, a;
+        //16 bit depth with depthFractionBits more, wraps around outside the primitive, where bounding box corners
+        //extrapolate it far out of range, and is exact again at every covered pixel
+        uint32_t z;
+    };
+    inline void stepInterpolants(Interpolants& value, const Interpolants& step)
+    {
+        value.s += step.s;
+        value.t += step.t;
+        value.r += step.r;
+        value.g += step.g;
+        value.b += step.b;
+        value.a += step.a;
+        value.z += step.z;
+    }
+    inline void advanceInterpolants(Interpolants& value, const Interpolants& step, int32_t count)
+    {
+        value.s += step.s * count;
+        value.t += step.t * count;
+        value.r += step.r * count;
+        value.g += step.g * count;
+        value.b += step.b * count;
+        value.a += step.a * count;
+        value.z += step.z * count;
+    }
+    int32_t floatToFixed(float value)
+    {
+        return static_cast<int32_t>(lroundf(std::clamp(value, -32767.f, 32767.f) * 65536.f));
+    }
+    //s and t with texCoordShift fractional bits, wrapped rather than clamped so GL_REPEAT keeps the fraction of any coordinate
+    int32_t floatToTexCoord(float value)
+    {
+        return static_cast<int32_t>(static_cast<uint32_t>(llroundf(std::clamp(value, -32767.f, 32767.f) * (1 << texCoordShift))));
+    }
+    inline uint16_t depthFromFixed(uint32_t z)
+    {
+        return std::clamp(static_cast<int32_t>(z) >> depthFractionBits, 0, 0xFFFF);
+    }
+    //the same for z that has not wrapped around
+    inline uint16_t depthFromFixed(int64_t z)
+    {
+        return std::clamp<int64_t>(z >> depthFractionBits, 0, 0xFFFF);
+    }
+    int32_t floatToDepth(float depth)
+    {
+        return static_cast<int32_t>(lroundf(depth * (1 << (16 + depthFractionBits))));
+    }
+    //with these functions a depth write can only bring a pixel closer, so depthMax stays an upper bound
+    bool depthOnlyDecreases(uint16_t func)
+    {
+        return func == GL_LESS || func == GL_LEQUAL || func == GL_EQUAL || func == GL_NEVER;
+    }
+
+    Context::StencilMask& currentStencilMask()
+    {
+        return *context->surfaceFirstFrameBuffer ? context->stencilMask.first : context->stencilMask.second;
+    }
+
+    //the fragment stages, shared by the generic path and the specialized span kernels
+    uint8_t texelSize(Context::Texture::Storage storage)
+    {
+        switch (storage)
+        {
+        case Context::Texture::RGBA8888: return 4;
+        case Context::Texture::RGB888: return 3;
+        case Context::Texture::Alpha8:
+        case Context::Texture::Luminance8: return 1;
+        default: return 2;
+        }
+    }
+    //one texel widened to RGBA 8888 in a word, r in the lowest byte like Context::Texture::RGBA in memory,
+    //the texture environment modulates so alpha and luminance textures keep the fragment color where they have none
+    template <Context::Texture::Storage Storage>
+    inline uint32_t texelRGBA(const void* data, uint32_t index)
+    {
+        if constexpr (Storage == Context::Texture::RGBA8888)
+            return static_cast<const uint32_t*>(data)[index];
+        else if constexpr (Storage == Context::Texture::RGB888)
+        {
+            const uint8_t* texel = static_cast<const uint8_t*>(data) + index * 3;
+            return texel[0] | texel[1] << 8 | texel[2] << 16 | 0xFF000000;
+        }
+        else if constexpr (Storage == Context::Texture::Alpha8)
+            return 0x00FFFFFF | static_cast<const uint8_t*>(data)[index] << 24;
+        else if constexpr (Storage == Context::Texture::Luminance8)
+            return static_cast<const uint8_t*>(data)[index] * 0x010101 | 0xFF000000;
+        else if constexpr (Storage == Context::Texture::LuminanceAlpha88)
+        {
+            const uint8_t* texel = static_cast<const uint8_t*>(data) + index * 2;
+            return texel[0] * 0x010101 | texel[1] << 24;
+        }
+        else
+        {
+            //channels widened by repeating their top bits, full scale stays full scale
+            const uint32_t texel = static_cast<const uint16_t*>(data)[index];
+            uint32_t r, g, b, a;
+            if constexpr (Storage == Context::Texture::RGB565)
+            {
+                r = texel >> 11, g = texel >> 5 & 0x3F, b = texel & 0x1F;
+                return (r << 3 | r >> 2) | (g << 2 | g >> 4) << 8 | (b << 3 | b >> 2) << 16 | 0xFF000000;
+            }
+            else if constexpr (Storage == Context::Texture::RGBA4444)
+            {
+                r = texel >> 12, g = texel >> 8 & 0xF, b = texel >> 4 & 0xF, a = texel & 0xF;
+                return (r | g << 8 | b << 16 | a << 24) * 0x11;
+            }
+            else
+            {
+                r = texel >> 11, g = texel >> 6 & 0x1F, b = texel >> 1 & 0x1F, a = texel & 1;
+                return (r << 3 | r >> 2) | (g << 3 | g >> 2) << 8 | (b << 3 | b >> 2) << 16 | (a ? 0xFF000000 : 0);
+            }
+        }
+    }
+    uint32_t texelRGBA(Context::Texture::Storage storage, const void* data, uint32_t index)
+    {
+        switch (storage)
+        {
+        case Context::Texture::RGB888: return texelRGBA<Context::Texture::RGB888>(data, index);
+        case Context::Texture::RGB565: return texelRGBA<Context::Texture::RGB565>(data, index);
+        case Context::Texture::RGBA4444: return texelRGBA<Context::Texture::RGBA4444>(data, index);
+        case Context::Texture::RGBA5551: return texelRGBA<Context::Texture::RGBA5551>(data, index);
+        case Context::Texture::Alpha8: return texelRGBA<Context::Texture::Alpha8>(data, index);
+        case Context::Texture::Luminance8: return texelRGBA<Context::Texture::Luminance8>(data, index);
+        case Context::Texture::LuminanceAlpha88: return texelRGBA<Context::Texture::LuminanceAlpha88>(data, index);
+        default: return texelRGBA<Context::Texture::RGBA8888>(data, index);
+        }
+    }
+    //texels a level of the given size is allocated for, tiled ones rounded up to whole blocks
+    uint32_t texelCount(uint16_t width, uint16_t height, bool tiled)
+    {
+        if (!tiled)
+            return width * height;
+        constexpr uint32_t mask = (1 << textureTileShift) - 1;
+        return ((width + mask) & ~mask) * ((height + mask) & ~mask);
+    }
+    //position of texel x, y in the data of a texture, in texels
+    template <bool Tiled>
+    inline uint32_t texelIndex(const Context::Texture& tex, uint32_t x, uint32_t y)
+    {
+        if constexpr (Tiled)
+        {
+            constexpr uint32_t mask = (1 << textureTileShift) - 1;
+            const uint32_t blocksPerRow = (tex.width + mask) >> textureTileShift;
+            return ((y >> textureTileShift) * blocksPerRow + (x >> textureTileShift)) << (2 * textureTileShift) | (y & mask) << textureTileShift | (x & mask);
+        }
+        else
+            return y * tex.width + x;
+    }
+    uint32_t texelIndex(const Context::Texture& tex, uint32_t x, uint32_t y)
+    {
+        return tex.tiled ? texelIndex<true>(tex, x, y) : texelIndex<false>(tex, x, y);
+    }
+    bool compressedStorage(Context::Texture::Storage storage)
+    {
+        return storage == Context::Texture::Palette4 || storage == Context::Texture::Palette8 || storage == Context::Texture::ETC1;
+    }
+    //bytes of a level, compressed ones rows of 4 bit indices without padding or 8 byte ETC1 blocks of 4x4 texels
+    uint32_t levelSize(uint16_t width, uint16_t height, Context::Texture::Storage storage, bool tiled)
+    {
+        switch (storage)
+        {
+        case Context::Texture::Palette4: return (width * height + 1) / 2;
+        case Context::Texture::Palette8: return width * height;
+        case Context::Texture::ETC1: return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+        default: return texelCount(width, height, tiled) * texelSize(storage);
+        }
+    }
+    //texel x, y of an ETC1 block, two sub-blocks each with a base color and a table of intensity modifiers
+    uint32_t etc1Texel(const uint8_t* block, uint32_t x, uint32_t y)
+    {
+        static constexpr int16_t modifiers[8][2] = { { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 } };
+        const bool flip = block[3] & 1;
+        const bool second = flip ? y >= 2 : x >= 2;
+        int32_t base[3];
+        for (uint8_t c = 0; c < 3; c++)
+        {
+            if (block[3] & 2)
+            {
+                //5 bit base and a 3 bit signed difference for the second sub-block
+                int32_t value = block[c] >> 3;
+                if (second)
+                    value += static_cast<int8_t>(block[c] << 5) >> 5;
+                base[c] = value << 3 | value >> 2;
+            }
+            else
+                base[c] = (second ? block[c] & 0xF : block[c] >> 4) * 0x11;
+        }
+        //pixel indices run down the columns, most significant bits in bytes 4 and 5
+        const uint8_t bit = x * 4 + y;
+        const uint16_t msb = block[4] << 8 | block[5];
+        const uint16_t lsb = block[6] << 8 | block[7];
+        const int16_t* table = modifiers[second ? block[3] >> 2 & 7 : block[3] >> 5];
+        const int32_t modifier = (msb >> bit & 1) ? -table[lsb >> bit & 1] : table[lsb >> bit & 1];
+        uint32_t texel = 0xFF000000;
+        for (uint8_t c = 0; c < 3; c++)
+            texel |= std::clamp(base[c] + modifier, 0, 255) << c * 8;
+        return texel;
+    }
+    //texel x, y of a level widened to RGBA8888, for every storage
+    template <Context::Texture::Storage Storage, bool Tiled>
+    inline uint32_t loadTexel(const Context::Texture& tex, uint32_t x, uint32_t y)
+    {
+        const uint8_t* data = static_cast<const uint8_t*>(tex.data);
+        if constexpr (Storage == Context::Texture::Palette4)
+        {
+            const uint32_t index = y * tex.width + x;
+            return tex.palette[index & 1 ? data[index >> 1] & 0xF : data[index >> 1] >> 4];
+        }
+        else if constexpr (Storage == Context::Texture::Palette8)
+            return tex.palette[data[y * tex.width + x]];
+        else if constexpr (Storage == Context::Texture::ETC1)
+            return etc1Texel(data + ((y >> 2) * ((tex.width + 3) >> 2) + (x >> 2)) * 8, x & 3, y & 3);
+        else
+            return texelRGBA<Storage>(tex.data, texelIndex<Tiled>(tex, x, y));
+    }
+    template <Context::Texture::Storage Storage>
+    uint32_t loadTexel(const Context::Texture& tex, uint32_t x, uint32_t y)
+    {
+        return tex.tiled ? loadTexel<Storage, true>(tex, x, y) : loadTexel<Storage, false>(tex, x, y);
+    }
+    uint32_t loadTexel(const Context::Texture& tex, uint32_t x, uint32_t y)
+    {
+        switch (tex.storage)
+        {
+        case Context::Texture::RGB888: return loadTexel<Context::Texture::RGB888>(tex, x, y);
+        case Context::Texture::RGB565: return loadTexel<Context::Texture::RGB565>(tex, x, y);
+        case Context::Texture::RGBA4444: return loadTexel<Context::Texture::RGBA4444>(tex, x, y);
+        case Context::Texture::RGBA5551: return loadTexel<Context::Texture::RGBA5551>(tex, x, y);
+        case Context::Texture::Alpha8: return loadTexel<Context::Texture::Alpha8>(tex, x, y);
+        case Context::Texture::Luminance8: return loadTexel<Context::Texture::Luminance8>(tex, x, y);
+        case Context::Texture::LuminanceAlpha88: return loadTexel<Context::Texture::LuminanceAlpha88>(tex, x, y);
+        case Context::Texture::Palette4: return loadTexel<Context::Texture::Palette4>(tex, x, y);
+        case Context::Texture::Palette8: return loadTexel<Context::Texture::Palette8>(tex, x, y);
+        case Context::Texture::ETC1: return loadTexel<Context::Texture::ETC1>(tex, x, y);
+        default: return loadTexel<Context::Texture::RGBA8888>(tex, x, y);
+        }
+    }
+    //texel x, y through the cache, a miss decodes the whole block, clamped to the texture at its right and bottom edge
+    template <Context::Texture::Storage Storage, bool Tiled>
+    inline uint32_t cachedTexel(const Context::Texture& tex, TexelCache& cache, uint32_t x, uint32_t y)
+    {
+        constexpr uint32_t mask = (1 << textureTileShift) - 1;
+        const uint32_t block = texelIndex<true>(tex, x, y) >> (2 * textureTileShift);
+        const uint32_t line = (reinterpret_cast<uintptr_t>(tex.data) >> 6 ^ block) & (texelCacheLines - 1);
+        uint32_t* texels = cache.texels + (line << (2 * textureTileShift));
+        TexelCache::Tag& tag = cache.tags[line];
+        if (tag.data == tex.data && tag.block == block)
+            cache.hits++;
+        else
+        {
+            cache.misses++;
+            tag.data = tex.data;
+            tag.block = block;
+            const uint32_t blockX = x & ~mask, blockY = y & ~mask;
+            for (uint32_t j = 0; j <= mask; j++)
+                for (uint32_t i = 0; i <= mask; i++)
+                    texels[j << textureTileShift | i] = loadTexel<Storage, Tiled>(tex, min<uint32_t>(blockX + i, tex.width - 1), min<uint32_t>(blockY + j, tex.height - 1));
+        }
+        return texels[(y & mask) << textureTileShift | (x & mask)];
+    }
+    template <Context::Texture::Storage Storage, bool Tiled, bool Cached>
+    inline uint32_t fetchTexel(const Context::Texture& tex, TexelCache* cache, uint32_t x, uint32_t y)
+    {
+        if constexpr (Cached)
+        {
+            if (cache)
+                return cachedTexel<Storage, Tiled>(tex, *cache, x, y);
+        }
+        return loadTexel<Storage, Tiled>(tex, x, y);
+    }
+    //the inverse for building mipmaps, channels rounded to the storage precision
+    void storeTexel(Context::Texture::Storage storage, void* data, uint32_t index, const uint8_t rgba[4])
+    {
+        uint8_t* bytes = static_cast<uint8_t*>(data) + index * texelSize(storage);
+        uint16_t* shorts = static_cast<uint16_t*>(data) + index;
+        switch (storage)
+        {
+        case Context::Texture::RGBA8888: memcpy(bytes, rgba, 4); break;
+        case Context::Texture::RGB888: memcpy(bytes, rgba, 3); break;
+        case Context::Texture::RGB565: *shorts = (rgba[0] * 31 + 127) / 255 << 11 | (rgba[1] * 63 + 127) / 255 << 5 | (rgba[2] * 31 + 127) / 255; break;
+        case Context::Texture::RGBA4444: *shorts = (rgba[0] + 8) / 17 << 12 | (rgba[1] + 8) / 17 << 8 | (rgba[2] + 8) / 17 << 4 | (rgba[3] + 8) / 17; break;
+        case Context::Texture::RGBA5551: *shorts = (rgba[0] * 31 + 127) / 255 << 11 | (rgba[1] * 31 + 127) / 255 << 6 | (rgba[2] * 31 + 127) / 255 << 1 | rgba[3] >> 7; break;
+        case Context::Texture::Alpha8: bytes[0] = rgba[3]; break;
+        case Context::Texture::Luminance8: bytes[0] = rgba[0]; break;
+        case Context::Texture::LuminanceAlpha88: bytes[0] = rgba[0]; bytes[1] = rgba[3]; break;
+        //compressed levels get no generated mipmaps
+        default: break;
+        }
+    }
+    //GL_REPEAT keeps the fraction of a coordinate, which wraps every texture size without a divide,
+    //GL_CLAMP_TO_EDGE clamps it to the texture, either way the result has 20 fractional bits so scaling it by a
+    //texture size fits 32 bits for sizes below 2048, glTexImage2D keeps them within glGetMaxTextureSize
+    inline int32_t wrapCoordinate(int32_t coord, bool repeat)
+    {
+        constexpr int32_t one = 1 << texCoordShift;
+        return (repeat ? coord & (one - 1) : std::clamp(coord, 0, one)) >> (texCoordShift - 20);
+    }
+    //the texels a linear sample at 24.8 texel coordinate u falls between, wrapped around or clamped to the edges
+    inline void linearTexels(int32_t u, uint16_t size, bool repeat, int32_t& first, int32_t& second)
+    {
+        first = u >> 8;
+        second = first + 1;
+        if (repeat)
+        {
+            if (first < 0)
+                first = size - 1;
+            if (second == size)
+                second = 0;
+        }
+        else
+        {
+            first = max(first, 0);
+            second = min<int32_t>(second, size - 1);
+        }
+    }
+    //GL_NEAREST, the texel the sample falls in
+    template <Context::Texture::Storage Storage, bool Tiled, bool Cached>
+    inline void sampleTexel(const DrawState& state, const Interpolants& in, TexelCache* cache, uint8_t src[4])
+    {
+        const Context::Texture& tex = *state.texture;
+        int16_t posX = (wrapCoordinate(in.s, state.repeatS) * tex.width) >> 20;
+        int16_t posY = (wrapCoordinate(in.t, state.repeatT) * tex.height) >> 20;
+        if (posX == tex.width)
+            posX--;
+        if (posY == tex.height)
+            posY--;
+        const uint32_t texel = fetchTexel<Storage, Tiled, Cached>(tex, cache, posX, posY);
+        memcpy(src, &texel, sizeof(texel));
+    }
+    //a + (b - a) * f / 256 rounded on all four bytes of two RGBA texels, two channels per multiply
+    inline uint32_t lerpTexel(uint32_t a, uint32_t b, uint32_t f)
+    {
+        const uint32_t rb = (((a & 0x00FF00FF) * (256 - f) + (b & 0x00FF00FF) * f + 0x00800080) >> 8) & 0x00FF00FF;
+        const uint32_t ga = ((a >> 8 & 0x00FF00FF) * (256 - f) + (b >> 8 & 0x00FF00FF) * f + 0x00800080) & 0xFF00FF00;
+        return rb | ga;
+    }
+    //GL_LINEAR, the four texels around the sample weighted by its 8 bit fractional position
+    template <Context::Texture::Storage Storage, bool Tiled, bool Cached>
+    inline void sampleTexelLinear(const DrawState& state, const Interpolants& in, TexelCache* cache, uint8_t src[4])
+    {
+        const Context::Texture& tex = *state.texture;
+        //24.8 texel coordinates relative to the texel centres, rounded so samples on a centre weigh its neighbours 0
+        const int32_t u = ((wrapCoordinate(in.s, state.repeatS) * tex.width + (1 << 11)) >> 12) - 128;
+        const int32_t v = ((wrapCoordinate(in.t, state.repeatT) * tex.height + (1 << 11)) >> 12) - 128;
+        int32_t x0, x1, y0, y1;
+        linearTexels(u, tex.width, state.repeatS, x0, x1);
+        linearTexels(v, tex.height, state.repeatT, y0, y1);
+        const uint32_t top = lerpTexel(fetchTexel<Storage, Tiled, Cached>(tex, cache, x0, y0), fetchTexel<Storage, Tiled, Cached>(tex, cache, x1, y0), u & 0xFF);
+        const uint32_t bottom = lerpTexel(fetchTexel<Storage, Tiled, Cached>(tex, cache, x0, y1), fetchTexel<Storage, Tiled, Cached>(tex, cache, x1, y1), u & 0xFF);
+        const uint32_t texel = lerpTexel(top, bottom, v & 0xFF);
+        memcpy(src, &texel, sizeof(texel));
+    }
+    template <Context::Texture::Storage Storage, bool Tiled>
+    TexelSampler pickFilter(bool linear, bool cached)
+    {
+        if (cached)
+            return linear ? sampleTexelLinear<Storage, Tiled, true> : sampleTexel<Storage, Tiled, true>;
+        return linear ? sampleTexelLinear<Storage, Tiled, false> : sampleTexel<Storage, Tiled, false>;
+    }
+    template <Context::Texture::Storage Storage>
+    TexelSampler pickLayout(bool linear, bool tiled, bool cached)
+    {
+        return tiled ? pickFilter<Storage, true>(linear, cached) : pickFilter<Storage, false>(linear, cached);
+    }
+    TexelSampler pickSampler(const Context::Texture& tex, bool linear, bool cached)
+    {
+        switch (tex.storage)
+        {
+        case Context::Texture::RGB888: return pickLayout<Context::Texture::RGB888>(linear, tex.tiled, cached);
+        case Context::Texture::RGB565: return pickLayout<Context::Texture::RGB565>(linear, tex.tiled, cached);
+        case Context::Texture::RGBA4444: return pickLayout<Context::Texture::RGBA4444>(linear, tex.tiled, cached);
+        case Context::Texture::RGBA5551: return pickLayout<Context::Texture::RGBA5551>(linear, tex.tiled, cached);
+        case Context::Texture::Alpha8: return pickLayout<Context::Texture::Alpha8>(linear, tex.tiled, cached);
+        case Context::Texture::Luminance8: return pickLayout<Context::Texture::Luminance8>(linear, tex.tiled, cached);
+        case Context::Texture::LuminanceAlpha88: return pickLayout<Context::Texture::LuminanceAlpha88>(linear, tex.tiled, cached);
+        case Context::Texture::Palette4: return pickFilter<Context::Texture::Palette4, false>(linear, cached);
+        case Context::Texture::Palette8: return pickFilter<Context::Texture::Palette8, false>(linear, cached);
+        case Context::Texture::ETC1: return pickFilter<Context::Texture::ETC1, false>(linear, cached);
+        default: return pickLayout<Context::Texture::RGBA8888>(linear, tex.tiled, cached);
+        }
+    }
+    //uncached row major RGBA8888 is sampled inline by the span kernels, every other texture through DrawState::sampler
+    bool samplesInline(const DrawState& state)
+    {
+        return state.texture->storage == Context::Texture::RGBA8888 && !state.texture->tiled && !state.texelCache;
+    }
+    inline void sampleTexture(const DrawState& state, const Interpolants& in, TexelCache* cache, float src[4])
+    {
+        uint8_t texel[4];
+        state.sampler(state, in, cache, texel);
+        src[0] *= texel[0] * oneDiv255;
+        src[1] *= texel[1] * oneDiv255;
+        src[2] *= texel[2] * oneDiv255;
+        src[3] *= texel[3] * oneDiv255;
+    }
+    inline void modulateColor(const Interpolants& in, float src[4])
+    {
+        src[0] *= in.r * (oneDiv255 * oneDiv65536);
+        src[1] *= in.g * (oneDiv255 * oneDiv65536);
+        src[2] *= in.b * (oneDiv255 * oneDiv65536);
+        src[3] *= in.a * (oneDiv255 * oneDiv65536);
+    }
+    template <typename T>
+    inline bool comparePasses(uint16_t func, T value, T ref)
+    {
+        switch (func)
+        {
+        case GL_NEVER: return false;
+        case GL_LESS: return value < ref;
+        case GL_LEQUAL: return value <= ref;
+        case GL_EQUAL: return value == ref;
+        case GL_GREATER: return value > ref;
+        case GL_NOTEQUAL: return value != ref;
+        case GL_GEQUAL: return value >= ref;
+        default: return true;
+        }
+    }
+    inline bool stencilPasses(const DrawState& state, uint8_t value)
+    {
+        return comparePasses<uint8_t>(state.stencilFunc, state.stencilRef & state.stencilValueMask, value & state.stencilValueMask);
+    }
+    bool isStencilOp(GLenum op)
+    {
+        return op == GL_KEEP || op == GL_ZERO || op == GL_REPLACE || op == GL_INCR || op == GL_DECR || op == GL_INVERT;
+    }
+    inline uint8_t applyStencilOp(const DrawState& state, uint16_t op, uint8_t value)
+    {
+        uint8_t result;
+        switch (op)
+        {
+        case GL_ZERO: result = 0; break;
+        case GL_REPLACE: result = state.stencilRef; break;
+        case GL_INCR: result = value == 0xFF ? value : value + 1; break;
+        case GL_DECR: result = value == 0 ? value : value - 1; break;
+        case GL_INVERT: result = ~value; break;
+        default: return value;
+        }
+        return (value & ~state.stencilWriteMask) | (result & state.stencilWriteMask);
+    }
+    //stencil test, depth test and their updates of one fragment in the order GL runs them, true if it may be written
+    inline bool depthStencilTest(const DrawState& state, const RenderTarget& target, uint32_t iBuf, uint16_t depth)
+    {
+        const bool depthPasses = !state.depthTest || comparePasses(state.depthFunc, depth, target.depth[iBuf]);
+        if (state.stencilTest)
+        {
+            uint8_t& stencil = target.stencil[iBuf];
+            if (!stencilPasses(state, stencil))
+            {
+                stencil = applyStencilOp(state, state.stencilFail, stencil);
+                return false;
+            }
+            stencil = applyStencilOp(state, depthPasses ? state.stencilZPass : state.stencilZFail, stencil);
+        }
+        if (!depthPasses)
+            return false;
+        if (state.depthTest && state.depthWrite)
+            target.depth[iBuf] = depth;
+        return true;
+    }
+    void blendFragment(uint16_t colorSrc, uint16_t colorDst, uint16_t alphaSrc, uint16_t alphaDst, float src[4], uint16_t dstColor, uint8_t dstAlpha)
+    {
+        float dst[4];
+        RGBFloatFrom565(dstColor, dst[0], dst[1], dst[2]);
+        dst[3] = dstAlpha * oneDiv255;
+
+        float result[4];
+        for (uint8_t i = 0; i < 3; i++)
+        {
+            const float sf = blendFactorCalc(colorSrc, src, dst, i);
+            const float df = blendFactorCalc(colorDst, src, dst, i);
+
+            result[i] = std::clamp(sf * src[i] + df * dst[i], 0.f, 1.f);
+        }
+        {
+            const float sf = blendFactorCalc(alphaSrc, src, dst, 3);
+            const float df = blendFactorCalc(alphaDst, src, dst, 3);
+
+            result[3] = std::clamp(sf * src[3] + df * dst[3], 0.f, 1.f);
+        }
+        for (uint8_t i = 0; i < 4; i++)
+            src[i] = result[i];
+    }
+    //integer twins of the stages above for the span kernels, colors in 0..255 and no float on the way
+    //x / 255 rounded down, exact for x < 65535
+    inline uint8_t div255(uint32_t x)
+    {
+        return (x + 1 + (x >> 8)) >> 8;
+    }
+    inline uint8_t colorFromFixed(int32_t value)
+    {
+        return std::clamp(value >> 16, 0, 255);
+    }
+    template <bool Texture>
+    inline void modulateColor(const Interpolants& in, uint8_t src[4])
+    {
+        if constexpr (Texture)
+        {
+            src[0] = div255(src[0] * colorFromFixed(in.r));
+            src[1] = div255(src[1] * colorFromFixed(in.g));
+            src[2] = div255(src[2] * colorFromFixed(in.b));
+            src[3] = div255(src[3] * colorFromFixed(in.a));
+        }
+        else
+        {
+            src[0] = colorFromFixed(in.r);
+            src[1] = colorFromFixed(in.g);
+            src[2] = colorFromFixed(in.b);
+            src[3] = colorFromFixed(in.a);
+        }
+    }
+    //565 channels widened the way RGBFloatFrom565 does, c * 8 / 256 and c * 4 / 256 of full scale
+    constexpr std::array<uint8_t, 64> makeExpandTable(uint8_t shift)
+    {
+        std::array<uint8_t, 64> table = {};
+        for (uint16_t i = 0; i < 64; i++)
+            table[i] = min(255, (i << shift) * 255 / 256);
+        return table;
+    }
+    constexpr std::array<uint8_t, 64> expand5 = makeExpandTable(3);
+    constexpr std::array<uint8_t, 64> expand6 = makeExpandTable(2);
+    template <uint16_t Factor>
+    inline uint8_t blendFactor(const uint8_t src[4], const uint8_t dst[4], uint8_t component)
+    {
+        if constexpr (Factor == GL_ZERO)
+            return 0;
+        else if constexpr (Factor == GL_ONE)
+            return 255;
+        else if constexpr (Factor == GL_SRC_COLOR)
+            return src[component];
+        else if constexpr (Factor == GL_ONE_MINUS_SRC_COLOR)
+            return 255 - src[component];
+        else if constexpr (Factor == GL_DST_COLOR)
+            return dst[component];
+        else if constexpr (Factor == GL_ONE_MINUS_DST_COLOR)
+            return 255 - dst[component];
+        else if constexpr (Factor == GL_SRC_ALPHA)
+            return src[3];
+        else if constexpr (Factor == GL_ONE_MINUS_SRC_ALPHA)
+            return 255 - src[3];
+        else if constexpr (Factor == GL_DST_ALPHA)
+            return dst[3];
+        else if constexpr (Factor == GL_ONE_MINUS_DST_ALPHA)
+            return 255 - dst[3];
+        else if constexpr (Factor == GL_SRC_ALPHA_SATURATE)
+            return component == 3 ? 255 : min<uint8_t>(src[3], 255 - dst[3]);
+        else
+            return 255;
+    }
+    template <uint16_t SrcFactor, uint16_t DstFactor>
+    inline uint8_t blendChannel(const uint8_t src[4], const uint8_t dst[4], uint8_t component)
+    {
+        const uint32_t sum = blendFactor<SrcFactor>(src, dst, component) * src[component] + blendFactor<DstFactor>(src, dst, component) * dst[component];
+        return sum >= 255 * 255 ? 255 : div255(sum);
+    }
+
+    int16_t fragmentShader(const DrawState& state, const Interpolants& in, TexelCache* cache, uint16_t dstColor, uint8_t dstAlpha, bool& discard, uint8_t& returnAlpha)
+    {
+        float src[4] = { 1.f, 1.f, 1.f, 1.f };
+        if (state.texture)
+            sampleTexture(state, in, cache, src);
+        if (state.useColorArray)
+            modulateColor(in, src);
+        if (state.alphaTest && !comparePasses(state.alphaFunc, src[3], state.alphaRef))
+        {
+            discard = true;
+            return 0;
+        }
+        if (state.blend)
+            blendFragment(state.blendColorSrc, state.blendColorDst, state.blendAlphaSrc, state.blendAlphaDst, src, dstColor, dstAlpha);
+        returnAlpha = src[3] * 255.f;
+        return RGBto565(src[0] * 255.f, src[1] * 255.f, src[2] * 255.f);
+    }
+    inline void shadePixel(const DrawState& state, const RenderTarget& target, uint32_t iBuf, const Interpolants& in)
+    {
+        //a fragment the alpha test cannot discard runs stencil and depth before it is shaded,
+        //otherwise they only count after the alpha test but occluded fragments are still never shaded
+        const uint16_t depth = depthFromFixed(in.z);
+        const bool early = !state.alphaTest;
+        if (early && !depthStencilTest(state, target, iBuf, depth))
+            return;
+        if (!early && !state.stencilTest && state.depthTest && !comparePasses(state.depthFunc, depth, target.depth[iBuf]))
+            return;
+
+        uint16_t dstColor = 0;
+        uint8_t dstAlpha = 255;
+        uint8_t returnAlpha = 255;
+        bool discard = false;
+
+        if (state.blend)
+        {
+            dstColor = swapBytes(target.color[iBuf]);
+            if (target.alpha)
+                dstAlpha = target.alpha[iBuf];
+        }
+
+        uint16_t color = fragmentShader(state, in, target.texelCache, dstColor, dstAlpha, discard, returnAlpha);
+
+        if (discard)
+            return;
+        if (!early && !depthStencilTest(state, target, iBuf, depth))
+            return;
+
+        target.color[iBuf] = swapBytes(color);
+        if (target.alpha)
+            target.alpha[iBuf] = returnAlpha;
+    }
+    void genericSpan(const DrawState& state, const RenderTarget& target, uint32_t iBuf, Interpolants in, const Interpolants& step, int32_t count)
+    {
+        for (; count > 0; count--, iBuf++)
+        {
+            shadePixel(state, target, iBuf, in);
+            stepInterpolants(in, step);
+        }
+    }
+    //how a span kernel reads texels, not at all, inlined for uncached row major RGBA8888 storage or through DrawState::sampler for the others
+    enum KernelTexture : uint8_t
+    {
+        TextureNone,
+        TextureNearest,
+        TextureLinear,
+        TextureSampler
+    };
+    //the common pipeline states with every per pixel decision made at compile time and integer math on 565 throughout,
+    //blending with GL_ONE, GL_ZERO means no blending
+    template <bool DepthTest, KernelTexture Texture, bool ColorArray, uint16_t AlphaFunc, uint16_t ColorSrc, uint16_t ColorDst, uint16_t AlphaSrc, uint16_t AlphaDst, bool AlphaBuffer>
+    void spanKernel(const DrawState& state, const RenderTarget& target, uint32_t iBuf, Interpolants in, const Interpolants& step, int32_t count)
+    {
+        constexpr bool blend = ColorSrc != GL_ONE || ColorDst != GL_ZERO || AlphaSrc != GL_ONE || AlphaDst != GL_ZERO;
+        for (; count > 0; count--, iBuf++, stepInterpolants(in, step))
+        {
+            uint16_t depth = 0;
+            if constexpr (DepthTest)
+            {
+                depth = depthFromFixed(in.z);
+                if (!comparePasses(state.depthFunc, depth, target.depth[iBuf]))
+                    continue;
+            }
+            uint8_t src[4] = { 255, 255, 255, 255 };
+            if constexpr (Texture == TextureLinear)
+                sampleTexelLinear<Context::Texture::RGBA8888, false, false>(state, in, nullptr, src);
+            else if constexpr (Texture == TextureNearest)
+                sampleTexel<Context::Texture::RGBA8888, false, false>(state, in, nullptr, src);
+            else if constexpr (Texture == TextureSampler)
+                state.sampler(state, in, target.texelCache, src);
+            if constexpr (ColorArray)
+                modulateColor<Texture != TextureNone>(in, src);
+            if constexpr (AlphaFunc != GL_ALWAYS)
+            {
+                if (!comparePasses<uint8_t>(AlphaFunc, src[3], state.alphaRef8))
+                    continue;
+            }
+            if constexpr (DepthTest)
+            {
+                if (state.depthWrite)
+                    target.depth[iBuf] = depth;
+            }
+            if constexpr (blend)
+            {
+                const uint16_t dstColor = swapBytes(target.color[iBuf]);
+                const uint8_t dst[4] = { expand5[dstColor >> 11], expand6[(dstColor >> 5) & 0x3F], expand5[dstColor & 0x1F],
+                    AlphaBuffer ? target.alpha[iBuf] : static_cast<uint8_t>(255) };
+                const uint8_t result[4] = { blendChannel<ColorSrc, ColorDst>(src, dst, 0), blendChannel<ColorSrc, ColorDst>(src, dst, 1),
+                    blendChannel<ColorSrc, ColorDst>(src, dst, 2), blendChannel<AlphaSrc, AlphaDst>(src, dst, 3) };
+                memcpy(src, result, sizeof(src));
+            }
+            target.color[iBuf] = swapBytes(RGBto565(src[0], src[1], src[2]));
+            if constexpr (AlphaBuffer)
+                target.alpha[iBuf] = src[3];
+        }
+    }
+    template <bool DepthTest, KernelTexture Texture, bool ColorArray, uint16_t AlphaFunc, uint16_t ColorSrc, uint16_t ColorDst, uint16_t AlphaSrc, uint16_t AlphaDst>
+    SpanKernel pickAlphaBuffer(bool alphaBuffer)
+    {
+        if (alphaBuffer)
+            return spanKernel<DepthTest, Texture, ColorArray, AlphaFunc, ColorSrc, ColorDst, AlphaSrc, AlphaDst, true>;
+        return spanKernel<DepthTest, Texture, ColorArray, AlphaFunc, ColorSrc, ColorDst, AlphaSrc, AlphaDst, false>;
+    }
+    template <bool DepthTest, KernelTexture Texture, bool ColorArray, uint16_t AlphaFunc>
+    SpanKernel pickBlend(const DrawState& state, bool alphaBuffer)
+    {
+        const uint16_t cs = state.blend ? state.blendColorSrc : GL_ONE;
+        const uint16_t cd = state.blend ? state.blendColorDst : GL_ZERO;
+        const uint16_t as = state.blend ? state.blendAlphaSrc : GL_ONE;
+        const uint16_t ad = state.blend ? state.blendAlphaDst : GL_ZERO;
+        if (cs == GL_ONE && cd == GL_ZERO && as == GL_ONE && ad == GL_ZERO)
+            return pickAlphaBuffer<DepthTest, Texture, ColorArray, AlphaFunc, GL_ONE, GL_ZERO, GL_ONE, GL_ZERO>(alphaBuffer);
+        if (cs == GL_SRC_ALPHA && cd == GL_ONE_MINUS_SRC_ALPHA && as == GL_SRC_ALPHA && ad == GL_ONE_MINUS_SRC_ALPHA)
+            return pickAlphaBuffer<DepthTest, Texture, ColorArray, AlphaFunc, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA>(alphaBuffer);
+        //SFML's BlendAlpha
+        if (cs == GL_SRC_ALPHA && cd == GL_ONE_MINUS_SRC_ALPHA && as == GL_ONE && ad == GL_ONE_MINUS_SRC_ALPHA)
+            return pickAlphaBuffer<DepthTest, Texture, ColorArray, AlphaFunc, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA>(alphaBuffer);
+        if (cs == GL_ONE && cd == GL_ONE_MINUS_SRC_ALPHA && as == GL_ONE && ad == GL_ONE_MINUS_SRC_ALPHA)
+            return pickAlphaBuffer<DepthTest, Texture, ColorArray, AlphaFunc, GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA>(alphaBuffer);
+        if (cs == GL_ONE && cd == GL_ONE && as == GL_ONE && ad == GL_ONE)
+            return pickAlphaBuffer<DepthTest, Texture, ColorArray, AlphaFunc, GL_ONE, GL_ONE, GL_ONE, GL_ONE>(alphaBuffer);
+        //SFML's BlendAdd
+        if (cs == GL_SRC_ALPHA && cd == GL_ONE && as == GL_ONE && ad == GL_ONE)
+            return pickAlphaBuffer<DepthTest, Texture, ColorArray, AlphaFunc, GL_SRC_ALPHA, GL_ONE, GL_ONE, GL_ONE>(alphaBuffer);
+        if (cs == GL_DST_COLOR && cd == GL_ZERO && as == GL_DST_COLOR && ad == GL_ZERO)
+            return pickAlphaBuffer<DepthTest, Texture, ColorArray, AlphaFunc, GL_DST_COLOR, GL_ZERO, GL_DST_COLOR, GL_ZERO>(alphaBuffer);
+        return nullptr;
+    }
+    template <bool DepthTest, KernelTexture Texture, bool ColorArray>
+    SpanKernel pickAlphaFunc(const DrawState& state, bool alphaBuffer)
+    {
+        if (!state.alphaTest || state.alphaFunc == GL_ALWAYS)
+            return pickBlend<DepthTest, Texture, ColorArray, GL_ALWAYS>(state, alphaBuffer);
+        if (state.alphaFunc == GL_GREATER)
+            return pickBlend<DepthTest, Texture, ColorArray, GL_GREATER>(state, alphaBuffer);
+        return nullptr;
+    }
+    template <bool DepthTest>
+    SpanKernel pickArrays(const DrawState& state, bool alphaBuffer)
+    {
+        if (state.texture && !samplesInline(state))
+            return state.useColorArray ? pickAlphaFunc<DepthTest, TextureSampler, true>(state, alphaBuffer) : pickAlphaFunc<DepthTest, TextureSampler, false>(state, alphaBuffer);
+        if (state.texture && state.textureLinear)
+            return state.useColorArray ? pickAlphaFunc<DepthTest, TextureLinear, true>(state, alphaBuffer) : pickAlphaFunc<DepthTest, TextureLinear, false>(state, alphaBuffer);
+        if (state.texture)
+            return state.useColorArray ? pickAlphaFunc<DepthTest, TextureNearest, true>(state, alphaBuffer) : pickAlphaFunc<DepthTest, TextureNearest, false>(state, alphaBuffer);
+        return state.useColorArray ? pickAlphaFunc<DepthTest, TextureNone, true>(state, alphaBuffer) : pickAlphaFunc<DepthTest, TextureNone, false>(state, alphaBuffer);
+    }
+    SpanKernel pickSpanKernel(const DrawState& state, bool alphaBuffer)
+    {
+        if (state.stencilTest)
+            return nullptr;
+        return state.depthTest ? pickArrays<true>(state, alphaBuffer) : pickArrays<false>(state, alphaBuffer);
+    }
+    //picking walks the whole state, a draw usually repeats one of the last few, so remember those
+    struct KernelCacheEntry
+    {
+        uint64_t key = 0;
+        SpanKernel kernel = nullptr;
+    };
+    std::array<KernelCacheEntry, 8> kernelCache;
+    SpanKernel lookupSpanKernel(const DrawState& state, bool alphaBuffer)
+    {
+        //blend factors are at most 0x308 and alpha functions 0x200 to 0x207
+        const uint64_t key = (state.texture != nullptr) | state.useColorArray << 1 | state.alphaTest << 2 | state.blend << 3 | alphaBuffer << 4 |
+            (state.alphaFunc & 0x7) << 5 | static_cast<uint64_t>(state.blendColorSrc & 0x3FF) << 8 | static_cast<uint64_t>(state.blendColorDst & 0x3FF) << 18 |
+            static_cast<uint64_t>(state.blendAlphaSrc & 0x3FF) << 28 | static_cast<uint64_t>(state.blendAlphaDst & 0x3FF) << 38 |
+            static_cast<uint64_t>(state.depthTest) << 48 | static_cast<uint64_t>(state.stencilTest) << 49 | static_cast<uint64_t>(state.textureLinear) << 50 |
+            static_cast<uint64_t>(state.texture && !samplesInline(state)) << 51;
+        KernelCacheEntry& entry = kernelCache[(key ^ key >> 8 ^ key >> 18 ^ key >> 28 ^ key >> 38) % kernelCache.size()];
+        if (entry.kernel && entry.key == key)
+            return entry.kernel;
+        entry.key = key;
+        entry.kernel = pickSpanKernel(state, alphaBuffer);
+        if (!entry.kernel)
+            entry.kernel = genericSpan;
+        return entry.kernel;
+    }
+    //a draw testing against a rectangular mask without changing it needs no per pixel stencil reads,
+    //the mask either lets everything through, nothing or exactly its rectangle
+    void applyStencilMask(DrawState& state)
+    {
+        const Context::StencilMask& mask = currentStencilMask();
+        if (!mask.known)
+            return;
+        const bool empty = mask.minX > mask.maxX;
+        const bool inside = !empty && stencilPasses(state, mask.inside);
+        const bool outside = stencilPasses(state, mask.outside);
+        if (outside && !inside && !empty)
+            return;
+        state.stencilTest = false;
+        if (outside)
+            return;
+        if (!inside)
+        {
+            state.clipMaxX = -1;
+            state.clipMaxY = -1;
+            return;
+        }
+        state.clipMinX = max(state.clipMinX, mask.minX);
+        state.clipMinY = max(state.clipMinY, mask.minY);
+        state.clipMaxX = min(state.clipMaxX, mask.maxX);
+        state.clipMaxY = min(state.clipMaxY, mask.maxY);
+    }
+    //where a draw takes texture coordinates and colors from
+    enum DrawSource : uint8_t
+    {
+        SourceArrays,
+        //texture coordinates generated across the point, colors from the arrays
+        SourcePointSprite,
+        //window coordinates, the crop rectangle of the enabled texture and no colors
+        SourceDrawTex
+    };
+    //every level down to 1x1 specified, each half the size of the one before, in the format, storage and layout of level 0,
+    //so the samplers picked for level 0 read all of them, otherwise minification samples level 0
+    bool mipmapComplete(const Context::Texture& tex)
+    {
+        if (tex.mipmaps.empty())
+            return false;
+        const Context::Texture* above = &tex;
+        for (const Context::Texture& level : tex.mipmaps)
+        {
+            if (!level.data || level.width != max(above->width >> 1, 1) || level.height != max(above->height >> 1, 1) ||
+                level.internalformat != tex.internalformat || level.storage != tex.storage || level.tiled != tex.tiled)
+                return false;
+            above = &level;
+        }
+        return above->width == 1 && above->height == 1;
+    }
+    DrawState captureDrawState(DrawSource source)
+    {
+        DrawState state;
+        collectUploads();
+        const Context::TextureUnit& unit = context->glTextureUnit[context->glClientActiveTexture];
+        const Context::TextureUnit& activeUnit = context->glTextureUnit[context->glActiveTexture];
+        const Context::Texture& tex = context->glTextures[activeUnit.glBoundTexture];
+        const bool useTexture = source == SourceArrays ? unit.glUseTexCoordArray : activeUnit.glEnabled;
+        if (useTexture && tex.data && !tex.uploading)
+        {
+            state.texture = &tex;
+            state.textureLinear = activeUnit.glTextureMagFilter == GL_LINEAR;
+            state.minifyLinear = activeUnit.glTextureMinFilter == GL_LINEAR || activeUnit.glTextureMinFilter == GL_LINEAR_MIPMAP_NEAREST ||
+                activeUnit.glTextureMinFilter == GL_LINEAR_MIPMAP_LINEAR;
+            state.texelCache = context->glTexelCache;
+            state.repeatS = activeUnit.glTextureWrapS == GL_REPEAT;
+            state.repeatT = activeUnit.glTextureWrapT == GL_REPEAT;
+            state.sampler = pickSampler(tex, state.textureLinear, state.texelCache);
+            state.mipmap = activeUnit.glTextureMinFilter != GL_NEAREST && activeUnit.glTextureMinFilter != GL_LINEAR &&
+                mipmapComplete(tex);
+        }
+        state.useColorArray = context->glUseColorArray && source != SourceDrawTex;
+        state.alphaTest = context->glAlphaTest;
+        state.alphaFunc = context->glAlphaFunc;
+        state.alphaRef = context->glAlphaRef;
+        state.alphaRef8 = context->glAlphaRef * 255.f;
+        state.depthTest = context->glDepthTest && (*context->surfaceFirstFrameBuffer ? context->depth.first : context->depth.second);
+        state.depthFunc = context->glDepthFunc;
+        state.depthWrite = context->glDepthMask;
+        state.stencilTest = context->glStencilTest && (*context->surfaceFirstFrameBuffer ? context->stencil.first : context->stencil.second);
+        state.stencilFunc = context->glStencilFunc;
+        state.stencilRef = context->glStencilRef;
+        state.stencilValueMask = context->glStencilValueMask;
+        state.stencilWriteMask = context->glStencilWriteMask;
+        state.stencilFail = context->glStencilFail;
+        state.stencilZFail = context->glStencilPassDepthFail;
+        state.stencilZPass = context->glStencilPassDepthPass;
+        state.stencilWrites = state.stencilTest && state.stencilWriteMask &&
+            (state.stencilFail != GL_KEEP || state.stencilZFail != GL_KEEP || state.stencilZPass != GL_KEEP);
+        scissorRect(state.clipMinX, state.clipMinY, state.clipMaxX, state.clipMaxY);
+        //the guard band lets geometry past the view volume sides, the viewport cuts it off
+        if (source != SourceDrawTex)
+        {
+            state.clipMinX = max<int32_t>(state.clipMinX, context->glViewportX);
+            state.clipMaxX = min<int32_t>(state.clipMaxX, context->glViewportX + context->glViewportWidth - 1);
+            state.clipMinY = max<int32_t>(state.clipMinY, context->height - context->glViewportY - context->glViewportHeight);
+            state.clipMaxY = min<int32_t>(state.clipMaxY, context->height - 1 - context->glViewportY);
+        }
+        if (state.stencilTest && !state.stencilWrites)
+            applyStencilMask(state);
+        state.blend = context->glBlend;
+        state.blendColorSrc = context->glBlendColorSrc;
+        state.blendAlphaSrc = context->glBlendAlphaSrc;
+        state.blendColorDst = context->glBlendColorDst;
+        state.blendAlphaDst = context->glBlendAlphaDst;
+        state.kernel = lookupSpanKernel(state, frameRenderTarget().alpha != nullptr);
+        state.minifyKernel = state.kernel;
+        if (state.minifyLinear != state.textureLinear)
+        {
+            DrawState minified = state;
+            minified.textureLinear = state.minifyLinear;
+            state.minifyKernel = lookupSpanKernel(minified, frameRenderTarget().alpha != nullptr);
+        }
+        return state;
+    }
+    struct EdgeFunction
+    {
+        int32_t stepX, stepY;
+        int32_t value;
+    };
+    EdgeFunction setupEdge(int32_t ax, int32_t ay, int32_t bx, int32_t by, int32_t px, int32_t py)
+    {
+        //E(p) = A * p.x + B * p.y + C, positive on the inner side of a -> b
+        const int32_t A = ay - by;
+        const int32_t B = bx - ax;
+        int64_t value = static_cast<int64_t>(A) * (px - ax) + static_cast<int64_t>(B) * (py - ay);
+        //top-left fill rule, pixels exactly on a bottom or right edge belong to the neighbour
+        if (!(A > 0 || (A == 0 && B > 0)))
+            value--;
+        return { A * (1 << rasterSubpixelBits), B * (1 << rasterSubpixelBits), static_cast<int32_t>(value) };
+    }
+    struct TriangleSetup
+    {
+        //edge values at the centre of pixel (minX, minY)
+        EdgeFunction edge[3];
+        int16_t minX, minY, maxX, maxY;
+        //plane equations, attributes at the centre of pixel (minX, minY) and their per pixel increments
+        Interpolants value, dx, dy;
+        //value.z before it wraps around, for the depth bounds of whole blocks
+        int64_t z;
+        //screen aligned rectangle covering exactly minX..maxX, minY..maxY, the edges are unused
+        bool rect;
+    };
+    Interpolants interpolantsAt(const TriangleSetup& setup, int32_t x, int32_t y)
+    {
+        const int32_t dx = x - setup.minX;
+        const int32_t dy = y - setup.minY;
+        Interpolants result;
+        result.s = setup.value.s + setup.dx.s * dx + setup.dy.s * dy;
+        result.t = setup.value.t + setup.dx.t * dx + setup.dy.t * dy;
+        result.r = setup.value.r + setup.dx.r * dx + setup.dy.r * dy;
+        result.g = setup.value.g + setup.dx.g * dx + setup.dy.g * dy;
+        result.b = setup.value.b + setup.dx.b * dx + setup.dy.b * dy;
+        result.a = setup.value.a + setup.dx.a * dx + setup.dy.a * dy;
+        result.z = setup.value.z + setup.dx.z * dx + setup.dy.z * dy;
+        return result;
+    }
+    //screen space in subpixel units through the viewport transform, y pointing down
+    bool snapVertex(const Vertex& vertex, int32_t& x, int32_t& y)
+    {
+        const float halfWidth = context->glViewportWidth * 0.5f;
+        const float halfHeight = context->glViewportHeight * 0.5f;
+        const float sx = vertex.pos[0] * halfWidth + (context->glViewportX + halfWidth);
+        const float sy = -vertex.pos[1] * halfHeight + (context->height - context->glViewportY - halfHeight);
+        if (!(fabsf(sx - context->width * 0.5f) <= rasterGuardBand && fabsf(sy - context->height * 0.5f) <= rasterGuardBand))
+            return false;
+        x = static_cast<int32_t>(lroundf(sx * (1 << rasterSubpixelBits)));
+        y = static_cast<int32_t>(lroundf(sy * (1 << rasterSubpixelBits)));
+        return true;
+    }
+    //a(x, y) = a0 + dadx * (x - x0) + dady * (y - y0), solved once per triangle
+    void setupInterpolants(const Vertex* const vert[3], const int32_t x[3], const int32_t y[3], int32_t startX, int32_t startY, TriangleSetup& setup)
+    {
+        const float subpixel = 1.f / (1 << rasterSubpixelBits);
+        const float x10 = (x[1] - x[0]) * subpixel, y10 = (y[1] - y[0]) * subpixel;
+        const float x20 = (x[2] - x[0]) * subpixel, y20 = (y[2] - y[0]) * subpixel;
+        const float oneDivArea = 1.f / (x10 * y20 - x20 * y10);
+        const float cx = (startX - x[0]) * subpixel, cy = (startY - y[0]) * subpixel;
+        auto plane = [&](float a0, float a1, float a2, float scale, int32_t& value, int32_t& dx, int32_t& dy, int32_t (*toFixed)(float))
+        {
+            const float a10 = (a1 - a0) * scale, a20 = (a2 - a0) * scale;
+            const float dadx = (a10 * y20 - a20 * y10) * oneDivArea;
+            const float dady = (a20 * x10 - a10 * x20) * oneDivArea;
+            value = toFixed(a0 * scale + dadx * cx + dady * cy);
+            dx = toFixed(dadx);
+            dy = toFixed(dady);
+        };
+        plane(vert[0]->tex[0], vert[1]->tex[0], vert[2]->tex[0], 1.f, setup.value.s, setup.dx.s, setup.dy.s, floatToTexCoord);
+        plane(vert[0]->tex[1], vert[1]->tex[1], vert[2]->tex[1], 1.f, setup.value.t, setup.dx.t, setup.dy.t, floatToTexCoord);
+        int32_t* color[4][3] = {
+            { &setup.value.r, &setup.dx.r, &setup.dy.r }, { &setup.value.g, &setup.dx.g, &setup.dy.g },
+            { &setup.value.b, &setup.dx.b, &setup.dy.b }, { &setup.value.a, &setup.dx.a, &setup.dy.a },
+        };
+        for (int8_t i = 0; i < 4; i++)
+            plane(std::clamp(vert[0]->col[i], 0.f, 1.f), std::clamp(vert[1]->col[i], 0.f, 1.f), std::clamp(vert[2]->col[i], 0.f, 1.f),
+                255.f, *color[i][0], *color[i][1], *color[i][2], floatToFixed);
+        float z[3];
+        const float depthScale = (context->glDepthRangeFar - context->glDepthRangeNear) * 0.5f;
+        for (int8_t i = 0; i < 3; i++)
+            z[i] = std::clamp(context->glDepthRangeNear + (vert[i]->pos[2] + 1.f) * depthScale, 0.f, 1.f);
+        //the increments are rounded first and z is extrapolated from vertex 0 with them in 64 bits, so every pixel
+        //stepped to gets the same value and only value.z wraps
+        constexpr float depthScale16 = 1 << (16 + depthFractionBits);
+        const float z10 = (z[1] - z[0]) * depthScale16, z20 = (z[2] - z[0]) * depthScale16;
+        const int32_t dzdx = static_cast<int32_t>(lroundf(std::clamp((z10 * y20 - z20 * y10) * oneDivArea, -2147483520.f, 2147483520.f)));
+        const int32_t dzdy = static_cast<int32_t>(lroundf(std::clamp((z20 * x10 - z10 * x20) * oneDivArea, -2147483520.f, 2147483520.f)));
+        setup.z = floatToDepth(z[0]) + ((static_cast<int64_t>(dzdx) * (startX - x[0]) + static_cast<int64_t>(dzdy) * (startY - y[0])) >> rasterSubpixelBits);
+        setup.value.z = static_cast<uint32_t>(setup.z);
+        setup.dx.z = static_cast<uint32_t>(dzdx);
+        setup.dy.z = static_cast<uint32_t>(dzdy);
+    }
+    bool cullTriangle(int64_t area)
+    {
+        if (!context->glCullFace)
+            return false;
+        const bool front = (context->glFrontFace == GL_CCW) == (area < 0);
+        return (context->glCullFaceMode == GL_BACK && !front) || (context->glCullFaceMode == GL_FRONT && front);
+    }
+    bool setupTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, TriangleSetup& setup)
+    {
+        const Vertex* vert[3] = { &v0, &v1, &v2 };
+        int32_t x[3], y[3];
+        for (int8_t i = 0; i < 3; i++)
+            if (!snapVertex(*vert[i], x[i], y[i]))
+                return false;
+
+        //y grows downwards here, so negative for triangles that are counter-clockwise in GL window coordinates
+        const int64_t area = static_cast<int64_t>(x[1] - x[0]) * (y[2] - y[0]) - static_cast<int64_t>(y[1] - y[0]) * (x[2] - x[0]);
+        if (area == 0 || cullTriangle(area))
+            return false;
+        if (area < 0)
+        {
+            std::swap(vert[1], vert[2]);
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+        }
+
+        const int32_t minX = max(0, min(x[0], min(x[1], x[2])) >> rasterSubpixelBits);
+        const int32_t maxX = min(context->width - 1, max(x[0], max(x[1], x[2])) >> rasterSubpixelBits);
+        const int32_t minY = max(0, min(y[0], min(y[1], y[2])) >> rasterSubpixelBits);
+        const int32_t maxY = min(context->height - 1, max(y[0], max(y[1], y[2])) >> rasterSubpixelBits);
+        if (minX > maxX || minY > maxY)
+            return false;
+        setup.minX = minX;
+        setup.minY = minY;
+        setup.maxX = maxX;
+        setup.maxY = maxY;
+
+        const int32_t startX = (minX << rasterSubpixelBits) + (1 << (rasterSubpixelBits - 1));
+        const int32_t startY = (minY << rasterSubpixelBits) + (1 << (rasterSubpixelBits - 1));
+        setup.edge[0] = setupEdge(x[1], y[1], x[2], y[2], startX, startY);
+        setup.edge[1] = setupEdge(x[2], y[2], x[0], y[0], startX, startY);
+        setup.edge[2] = setupEdge(x[0], y[0], x[1], y[1], startX, startY);
+        setupInterpolants(vert, x, y, startX, startY, setup);
+        setup.rect = false;
+        return true;
+    }
+    //two triangles of an affine draw that together cover a screen aligned rectangle, as SFML sprites and shapes do.
+    //returns false if the pair has to go through the triangle path, true if it was set up or is not visible at all
+    bool setupRect(const Vertex* const a[3], const Vertex* const b[3], TriangleSetup& setup, bool& visible)
+    {
+        visible = false;
+        const Vertex* vert[6] = { a[0], a[1], a[2], b[0], b[1], b[2] };
+        int32_t x[6], y[6];
+        for (int8_t i = 0; i < 6; i++)
+        {
+            if (vert[i]->pos[3] != 1.f || vert[i]->pos[2] < -1.f || vert[i]->pos[2] > 1.f || !snapVertex(*vert[i], x[i], y[i]))
+                return false;
+        }
+        const int32_t left = *std::min_element(x, x + 6), right = *std::max_element(x, x + 6);
+        const int32_t top = *std::min_element(y, y + 6), bottom = *std::max_element(y, y + 6);
+        if (left == right || top == bottom)
+            return false;
+
+        //every vertex on a corner, each triangle missing the corner opposite of the other one
+        const Vertex* corner[4] = {};
+        uint8_t used[2] = { 0, 0 };
+        for (int8_t i = 0; i < 6; i++)
+        {
+            if ((x[i] != left && x[i] != right) || (y[i] != top && y[i] != bottom))
+                return false;
+            const uint8_t c = (x[i] == right) | (y[i] == bottom) << 1;
+            if (corner[c] && memcmp(corner[c]->col, vert[i]->col, sizeof(vert[i]->col)) != 0)
+                return false;
+            if (corner[c] && memcmp(corner[c]->tex, vert[i]->tex, sizeof(vert[i]->tex)) != 0)
+                return false;
+            if (corner[c] && corner[c]->pos[2] != vert[i]->pos[2])
+                return false;
+            corner[c] = vert[i];
+            used[i / 3] |= 1 << c;
+        }
+        //corner c and 3 - c are opposite
+        uint8_t missing[2];
+        for (int8_t t = 0; t < 2; t++)
+        {
+            switch (used[t] ^ 0xF)
+            {
+            case 1: missing[t] = 0; break;
+            case 2: missing[t] = 1; break;
+            case 4: missing[t] = 2; break;
+            case 8: missing[t] = 3; break;
+            default: return false;
+            }
+        }
+        if ((missing[0] ^ missing[1]) != 3)
+            return false;
+        //both halves have to share one plane per attribute
+        for (int8_t i = 0; i < 4; i++)
+        {
+            if (fabsf(corner[0]->col[i] + corner[3]->col[i] - corner[1]->col[i] - corner[2]->col[i]) > 0.00001f ||
+                fabsf(corner[0]->tex[i] + corner[3]->tex[i] - corner[1]->tex[i] - corner[2]->tex[i]) > 0.00001f)
+                return false;
+        }
+        if (fabsf(corner[0]->pos[2] + corner[3]->pos[2] - corner[1]->pos[2] - corner[2]->pos[2]) > 0.00001f)
+            return false;
+
+        const int64_t areaA = static_cast<int64_t>(x[1] - x[0]) * (y[2] - y[0]) - static_cast<int64_t>(y[1] - y[0]) * (x[2] - x[0]);
+        const int64_t areaB = static_cast<int64_t>(x[4] - x[3]) * (y[5] - y[3]) - static_cast<int64_t>(y[4] - y[3]) * (x[5] - x[3]);
+        if ((areaA > 0) != (areaB > 0))
+            return false;
+        if (cullTriangle(areaA))
+            return true;
+
+        //pixel centres inside [left, right) x [top, bottom), the same pixels the fill rule gives the two triangles
+        const int32_t half = 1 << (rasterSubpixelBits - 1);
+        const int32_t minX = max(0, (left + half - 1) >> rasterSubpixelBits);
+        const int32_t maxX = min(context->width - 1, ((right + half - 1) >> rasterSubpixelBits) - 1);
+        const int32_t minY = max(0, (top + half - 1) >> rasterSubpixelBits);
+        const int32_t maxY = min(context->height - 1, ((bottom + half - 1) >> rasterSubpixelBits) - 1);
+        if (minX > maxX || minY > maxY)
+            return true;
+        setup.minX = minX;
+        setup.minY = minY;
+        setup.maxX = maxX;
+        setup.maxY = maxY;
+        setupInterpolants(a, x, y, (minX << rasterSubpixelBits) + half, (minY << rasterSubpixelBits) + half, setup);
+        setup.rect = true;
+        visible = true;
+        return true;
+    }
+    //attributes of a divided vertex in the fixed point formats of Interpolants
+    Interpolants vertexInterpolants(const Vertex& vertex)
+    {
+        Interpolants result;
+        result.s = floatToTexCoord(vertex.tex[0]);
+        result.t = floatToTexCoord(vertex.tex[1]);
+        result.r = floatToFixed(std::clamp(vertex.col[0], 0.f, 1.f) * 255.f);
+        result.g = floatToFixed(std::clamp(vertex.col[1], 0.f, 1.f) * 255.f);
+        result.b = floatToFixed(std::clamp(vertex.col[2], 0.f, 1.f) * 255.f);
+        result.a = floatToFixed(std::clamp(vertex.col[3], 0.f, 1.f) * 255.f);
+        const float depthScale = (context->glDepthRangeFar - context->glDepthRangeNear) * 0.5f;
+        result.z = floatToDepth(std::clamp(context->glDepthRangeNear + (vertex.pos[2] + 1.f) * depthScale, 0.f, 1.f));
+        return result;
+    }
+    //the square an aliased point or point sprite covers, texture coordinates running 0..1 across it for sprites
+    bool setupPoint(const Vertex& vertex, float size, bool sprite, TriangleSetup& setup)
+    {
+        const float halfWidth = context->glViewportWidth * 0.5f;
+        const float halfHeight = context->glViewportHeight * 0.5f;
+        //window coordinates with y up, the way GL places the square
+        const float x = vertex.pos[0] * halfWidth + (context->glViewportX + halfWidth);
+        const float y = vertex.pos[1] * halfHeight + (context->glViewportY + halfHeight);
+        const int32_t side = max(1, static_cast<int32_t>(lroundf(size)));
+        const int32_t left = side & 1 ? static_cast<int32_t>(floorf(x)) - (side - 1) / 2 : static_cast<int32_t>(floorf(x + 0.5f)) - side / 2;
+        const int32_t bottom = side & 1 ? static_cast<int32_t>(floorf(y)) - (side - 1) / 2 : static_cast<int32_t>(floorf(y + 0.5f)) - side / 2;
+        const int32_t minX = max(0, left);
+        const int32_t maxX = min(context->width - 1, left + side - 1);
+        const int32_t minY = max(0, context->height - bottom - side);
+        const int32_t maxY = min(context->height - 1, context->height - 1 - bottom);
+        if (minX > maxX || minY > maxY)
+            return false;
+        setup.minX = minX;
+        setup.minY = minY;
+        setup.maxX = maxX;
+        setup.maxY = maxY;
+        setup.value = vertexInterpolants(vertex);
+        setup.dx = {};
+        setup.dy = {};
+        setup.z = setup.value.z;
+        if (sprite)
+        {
+            //s = 1/2 + (x_f + 1/2 - x_w) / size, t = 1/2 - (y_f + 1/2 - y_w) / size with rows counted from the top
+            setup.value.s = floatToTexCoord(0.5f + (minX + 0.5f - x) / size);
+            setup.value.t = floatToTexCoord(0.5f + (minY + 0.5f - (context->height - y)) / size);
+            setup.dx.s = floatToTexCoord(1.f / size);
+            setup.dy.t = floatToTexCoord(1.f / size);
+        }
+        setup.rect = true;
+        return true;
+    }
+    void rasterizeTriangle(const TriangleSetup& setup, const DrawState& state, const RenderTarget& target)
+    {
+        const int32_t minX = max<int32_t>(max(setup.minX, state.clipMinX), target.minX);
+        const int32_t maxX = min<int32_t>(min(setup.maxX, state.clipMaxX), target.maxX);
+        const int32_t minY = max<int32_t>(max(setup.minY, state.clipMinY), target.minY);
+        const int32_t maxY = min<int32_t>(min(setup.maxY, state.clipMaxY), target.maxY);
+        if (minX > maxX || minY > maxY)
+            return;
+
+        //coarse pass over screen aligned blocks, the edge functions are linear so the
+        //block corners bound every pixel inside
+        for (int32_t by = minY & ~(rasterBlockSize - 1); by <= maxY; by += rasterBlockSize)
+        {
+            const int32_t y0 = max(by, minY);
+            const int32_t y1 = min(by + rasterBlockSize - 1, maxY);
+            for (int32_t bx = minX & ~(rasterBlockSize - 1); bx <= maxX; bx += rasterBlockSize)
+            {
+                const int32_t x0 = max(bx, minX);
+                const int32_t x1 = min(bx + rasterBlockSize - 1, maxX);
+                EdgeFunction e[3];
+                bool outside = false;
+                bool covered = true;
+                for (int8_t i = 0; i < 3; i++)
+                {
+                    e[i] = setup.edge[i];
+                    e[i].value += (x0 - setup.minX) * e[i].stepX + (y0 - setup.minY) * e[i].stepY;
+                    const int32_t spanX = (x1 - x0) * e[i].stepX;
+                    const int32_t spanY = (y1 - y0) * e[i].stepY;
+                    if (e[i].value + max(spanX, 0) + max(spanY, 0) < 0)
+                        outside = true;
+                    if (e[i].value + min(spanX, 0) + min(spanY, 0) < 0)
+                        covered = false;
+                }
+                if (outside)
+                    continue;
+
+                Interpolants row = interpolantsAt(setup, x0, y0);
+                uint16_t* blockDepthMax = nullptr;
+                uint16_t blockDepth = 0xFFFF;
+                if (state.depthTest && (state.depthWrite || !state.stencilWrites))
+                    blockDepthMax = &target.depthMax[by / rasterBlockSize * depthMaxStride() + bx / rasterBlockSize];
+                if (blockDepthMax && !state.stencilWrites)
+                {
+                    //z is linear as well, reject the block when even its nearest corner is behind everything stored,
+                    //not while stencil writes, the depth fail operation still has to run on its pixels
+                    const int32_t dzdx = static_cast<int32_t>(setup.dx.z), dzdy = static_cast<int32_t>(setup.dy.z);
+                    const int64_t z = setup.z + static_cast<int64_t>(dzdx) * (x0 - setup.minX) + static_cast<int64_t>(dzdy) * (y0 - setup.minY);
+                    const int64_t spanX = static_cast<int64_t>(dzdx) * (x1 - x0);
+                    const int64_t spanY = static_cast<int64_t>(dzdy) * (y1 - y0);
+                    const uint16_t nearest = depthFromFixed(z + min<int64_t>(spanX, 0) + min<int64_t>(spanY, 0));
+                    if ((state.depthFunc == GL_LESS && nearest >= *blockDepthMax) || (state.depthFunc == GL_LEQUAL && nearest > *blockDepthMax))
+                        continue;
+                    blockDepth = depthFromFixed(z + max<int64_t>(spanX, 0) + max<int64_t>(spanY, 0));
+                }
+
+                for (int32_t iy = y0; iy <= y1; iy++)
+                {
+                    const uint32_t iBuf = (iy - target.originY) * target.stride + x0 - target.originX;
+                    if (covered)
+                        state.kernel(state, target, iBuf, row, setup.dx, x1 - x0 + 1);
+                    else
+                    {
+                        //the triangle is convex, so the covered pixels of a row form one span
+                        int32_t w0 = e[0].value;
+                        int32_t w1 = e[1].value;
+                        int32_t w2 = e[2].value;
+                        int32_t ix = x0;
+                        for (; ix <= x1 && (w0 | w1 | w2) < 0; ix++, w0 += e[0].stepX, w1 += e[1].stepX, w2 += e[2].stepX);
+                        const int32_t start = ix;
+                        for (; ix <= x1 && (w0 | w1 | w2) >= 0; ix++, w0 += e[0].stepX, w1 += e[1].stepX, w2 += e[2].stepX);
+                        if (ix > start)
+                        {
+                            Interpolants in = row;
+                            advanceInterpolants(in, setup.dx, start - x0);
+                            state.kernel(state, target, iBuf + start - x0, in, setup.dx, ix - start);
+                        }
+                    }
+                    e[0].value += e[0].stepY;
+                    e[1].value += e[1].stepY;
+                    e[2].value += e[2].stepY;
+                    stepInterpolants(row, setup.dy);
+                }
+
+                if (blockDepthMax && state.depthWrite)
+                {
+                    //a block written completely without discards holds nothing farther than the triangle or what it failed against
+                    const bool wholeBlock = covered && x0 == bx && y0 == by && x1 == min(bx + rasterBlockSize - 1, context->width - 1) &&
+                        y1 == min(by + rasterBlockSize - 1, context->height - 1);
+                    if (!depthOnlyDecreases(state.depthFunc))
+                        *blockDepthMax = 0xFFFF;
+                    else if (wholeBlock && !state.alphaTest && !state.stencilTest && (state.depthFunc == GL_LESS || state.depthFunc == GL_LEQUAL))
+                        *blockDepthMax = min(*blockDepthMax, blockDepth);
+                }
+            }
+        }
+    }
+    //depth writes that may push pixels back leave the hierarchical z of the touched blocks unknown
+    void invalidateDepthMax(const RenderTarget& target, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY)
+    {
+        for (int32_t by = minY / rasterBlockSize; by <= maxY / rasterBlockSize; by++)
+            std::fill_n(target.depthMax + by * depthMaxStride() + minX / rasterBlockSize, maxX / rasterBlockSize - minX / rasterBlockSize + 1, 0xFFFF);
+    }
+
+    //true if texels first, first + direction, .. first + count * direction of a texture of the given size are hit exactly
+    //once each, one per pixel step forwards or backwards, linear filtering also needs every sample within the half 1/256
+    //texel of a texel centre that the sampler rounds onto it, where the neighbours weigh 0
+    bool texelRun(int32_t start, int32_t step, uint16_t size, int32_t count, bool linear, int32_t& first, int32_t& direction)
+    {
+        constexpr int64_t one = 1 << texCoordShift;
+        const int64_t pos = static_cast<int64_t>(start) * size - (linear ? one / 2 - (one >> 9) : 0);
+        const int64_t limit = linear ? one >> 8 : one;
+        if (start < 0 || pos < 0 || (pos & (one - 1)) >= limit)
+            return false;
+        first = pos >> texCoordShift;
+        direction = step < 0 ? -1 : 1;
+        const int64_t end = (pos & (one - 1)) + static_cast<int64_t>(count) * (static_cast<int64_t>(step) * size - direction * one);
+        const int32_t last = first + direction * count;
+        return end >= 0 && end < limit && last >= 0 && last < size;
+    }
+    void rasterizeRect(const TriangleSetup& setup, const DrawState& state, const RenderTarget& target)
+    {
+        const int32_t minX = max<int32_t>(max(setup.minX, state.clipMinX), target.minX);
+        const int32_t maxX = min<int32_t>(min(setup.maxX, state.clipMaxX), target.maxX);
+        const int32_t minY = max<int32_t>(max(setup.minY, state.clipMinY), target.minY);
+        const int32_t maxY = min<int32_t>(min(setup.maxY, state.clipMaxY), target.maxY);
+        if (minX > maxX || minY > maxY)
+            return;
+        Interpolants row = interpolantsAt(setup, minX, minY);
+        const bool constantColor = !state.useColorArray || (setup.dx.r | setup.dy.r | setup.dx.g | setup.dy.g | setup.dx.b | setup.dy.b | setup.dx.a | setup.dy.a) == 0;
+
+        //untextured and unblended, every pixel gets the same value
+        if (!state.texture && !state.blend && !state.depthTest && !state.stencilTest && constantColor)
+        {
+            bool discard = false;
+            uint8_t alpha = 255;
+            const uint16_t color = swapBytes(fragmentShader(state, row, target.texelCache, 0, 255, discard, alpha));
+            if (discard)
+                return;
+            for (int32_t iy = minY; iy <= maxY; iy++)
+            {
+                const uint32_t iBuf = (iy - target.originY) * target.stride + minX - target.originX;
+                std::fill_n(target.color + iBuf, maxX - minX + 1, color);
+                if (target.alpha)
+                    std::fill_n(target.alpha + iBuf, maxX - minX + 1, alpha);
+            }
+            return;
+        }
+
+        //one texel per pixel and nothing to modulate, blend or test, a plain copy out of a row major RGBA8888 or RGB565 texture
+        const bool white = !state.useColorArray || (constantColor && row.r == 255 << 16 && row.g == 255 << 16 && row.b == 255 << 16 && row.a == 255 << 16);
+        const bool copyable = state.texture && !state.texture->tiled &&
+            (state.texture->storage == Context::Texture::RGBA8888 || state.texture->storage == Context::Texture::RGB565);
+        //glDrawTexOES steps t down the texture, rows are then copied bottom-up
+        int32_t texelX, texelY, directionX, directionY;
+        if (copyable && !state.blend && !state.alphaTest && !state.depthTest && !state.stencilTest && white && setup.dy.s == 0 && setup.dx.t == 0 &&
+            texelRun(row.s, setup.dx.s, state.texture->width, maxX - minX, state.textureLinear, texelX, directionX) &&
+            texelRun(row.t, setup.dy.t, state.texture->height, maxY - minY, state.textureLinear, texelY, directionY))
+        {
+            const Context::Texture& tex = *state.texture;
+            for (int32_t iy = minY, first = texelY * tex.width + texelX; iy <= maxY; iy++, first += directionY * tex.width)
+            {
+                const uint32_t iBuf = (iy - target.originY) * target.stride + minX - target.originX;
+                if (tex.storage == Context::Texture::RGB565)
+                {
+                    const uint16_t* texels = static_cast<const uint16_t*>(tex.data) + first;
+                    for (int32_t i = 0; i <= maxX - minX; i++)
+                        target.color[iBuf + i] = swapBytes(texels[i * directionX]);
+                    if (target.alpha)
+                        std::fill_n(target.alpha + iBuf, maxX - minX + 1, 255);
+                    continue;
+                }
+                const Context::Texture::RGBA* texels = static_cast<const Context::Texture::RGBA*>(tex.data) + first;
+                for (int32_t i = 0; i <= maxX - minX; i++)
+                    target.color[iBuf + i] = swapBytes(RGBto565(texels[i * directionX].r, texels[i * directionX].g, texels[i * directionX].b));
+                if (target.alpha)
+                    for (int32_t i = 0; i <= maxX - minX; i++)
+                        target.alpha[iBuf + i] = texels[i * directionX].a;
+            }
+            return;
+        }
+
+        for (int32_t iy = minY; iy <= maxY; iy++)
+        {
+            state.kernel(state, target, (iy - target.originY) * target.stride + minX - target.originX, row, setup.dx, maxX - minX + 1);
+            stepInterpolants(row, setup.dy);
+        }
+        if (state.depthTest && state.depthWrite && !depthOnlyDecreases(state.depthFunc))
+            invalidateDepthMax(target, minX, minY, maxX, maxY);
+    }
+    //squared texels per pixel step of a setup along its steeper screen axis, in 16.16 texels, above 1 << 32 it minifies
+    float textureScale(const TriangleSetup& setup, const Context::Texture& tex)
+    {
+        constexpr float toFixed = 1.f / (1 << (texCoordShift - 16));
+        const float dsdx = static_cast<float>(setup.dx.s) * tex.width * toFixed;
+        const float dtdx = static_cast<float>(setup.dx.t) * tex.height * toFixed;
+        const float dsdy = static_cast<float>(setup.dy.s) * tex.width * toFixed;
+        const float dtdy = static_cast<float>(setup.dy.t) * tex.height * toFixed;
+        return max(dsdx * dsdx + dtdx * dtdx, dsdy * dsdy + dtdy * dtdy);
+    }
+    //the level nearest to the lod of the whole setup, log2 of its texel to pixel ratio, each level quarters the scale
+    const Context::Texture& mipmapLevel(const Context::Texture& tex, float scale)
+    {
+        const Context::Texture* level = &tex;
+        for (float limit = 2.f * 65536.f * 65536.f; scale >= limit; limit *= 4.f)
+        {
+            const size_t next = level == &tex ? 0 : level - tex.mipmaps.data() + 1;
+            if (next == tex.mipmaps.size() || !tex.mipmaps[next].data)
+                break;
+            level = &tex.mipmaps[next];
+        }
+        return *level;
+    }
+    void rasterize(const TriangleSetup& setup, const DrawState& state, const RenderTarget& target)
+    {
+        if (state.texture && (state.minifyLinear != state.textureLinear || state.mipmap))
+        {
+            const float scale = textureScale(setup, *state.texture);
+            if (scale > 65536.f * 65536.f)
+            {
+                DrawState minified = state;
+                minified.textureLinear = state.minifyLinear;
+                minified.sampler = pickSampler(*state.texture, state.minifyLinear, state.texelCache);
+                minified.kernel = state.minifyKernel;
+                if (state.mipmap)
+                    minified.texture = &mipmapLevel(*state.texture, scale);
+                if (setup.rect)
+                    rasterizeRect(setup, minified, target);
+                else
+                    rasterizeTriangle(setup, minified, target);
+                return;
+            }
+        }
+        if (setup.rect)
+            rasterizeRect(setup, state, target);
+        else
+            rasterizeTriangle(setup, state, target);
+    }
+
+    //deferred rendering, triangles are sorted into screen tiles and drawn by resolveBins
+    struct BinnedTriangle
+    {
+        TriangleSetup setup;
+        uint16_t state;
+    };
+    //resident in internal RAM, the frame buffer is only touched on tile load and store
+    struct TileMemory
+    {
+        uint16_t* color = nullptr;
+        uint8_t* alpha = nullptr;
+        uint16_t* depth = nullptr;
+        uint8_t* stencil = nullptr;
+    };
+    struct TileBinner
+    {
+        std::vector<DrawState> states;
+        std::vector<BinnedTriangle> triangles;
+        std::vector<std::vector<uint32_t>> bins;
+        uint16_t tilesX = 0;
+        uint16_t tilesY = 0;
+        //one per raster worker
+        std::vector<TileMemory> tiles;
+        //the context the grid and the tiles were sized for, with the size and attachments of its surface then
+        const Context* owner = nullptr;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        bool depth = false;
+        bool stencil = false;
+        bool alpha = false;
+        bool pendingClear = false;
+        uint16_t clearColor = 0;
+        uint8_t clearAlpha = 0;
+        bool pendingDepthClear = false;
+        uint16_t clearDepth = 0xFFFF;
+        //depth only goes through the tiles when a binned draw tests it
+        bool usesDepth = false;
+        bool usesStencil = false;
+
+        //filled by resolveBins for the raster workers
+        std::vector<uint16_t> work;
+        std::atomic<uint32_t> nextWork;
+        RenderTarget frame;
+    };
+    TileBinner binner;
+    Scheduler scheduler;
+
+    void freeTileMemory()
+    {
+        for (TileMemory& tile : binner.tiles)
+        {
+            if (tile.color)
+                heap_caps_free(tile.color);
+            if (tile.alpha)
+                heap_caps_free(tile.alpha);
+            if (tile.depth)
+                heap_caps_free(tile.depth);
+            if (tile.stencil)
+                heap_caps_free(tile.stencil);
+        }
+        binner.tiles.clear();
+    }
+    //drops the grid and the tiles when another context, or its surface with another size or attachments, became current,
+    //eglMakeCurrent flushes first, so no binned triangle refers to them
+    void syncBinner()
+    {
+        if (binner.owner == context && binner.width == context->width && binner.height == context->height &&
+            binner.depth == (context->depth.first != nullptr) && binner.stencil == (context->stencil.first != nullptr) &&
+            binner.alpha == (context->alpha.first != nullptr))
+            return;
+        freeTileMemory();
+        binner.bins.clear();
+        binner.tilesX = 0;
+        binner.tilesY = 0;
+        binner.owner = context;
+        binner.width = context->width;
+        binner.height = context->height;
+        binner.depth = context->depth.first != nullptr;
+        binner.stencil = context->stencil.first != nullptr;
+        binner.alpha = context->alpha.first != nullptr;
+    }
+    void initBins()
+    {
+        syncBinner();
+        if (binner.tilesX != 0)
+            return;
+        binner.tilesX = (context->width + tileSize - 1) / tileSize;
+        binner.tilesY = (context->height + tileSize - 1) / tileSize;
+        binner.bins.resize(binner.tilesX * binner.tilesY);
+    }
+    void initTileMemory()
+    {
+        syncBinner();
+        while (binner.tiles.size() < scheduler.workerCount())
+        {
+            TileMemory tile;
+            tile.color = static_cast<uint16_t*>(heap_caps_malloc(tileSize * tileSize * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+            if (binner.alpha)
+                tile.alpha = static_cast<uint8_t*>(heap_caps_malloc(tileSize * tileSize * sizeof(uint8_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+            if (binner.depth)
+                tile.depth = static_cast<uint16_t*>(heap_caps_malloc(tileSize * tileSize * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+            if (binner.stencil)
+                tile.stencil = static_cast<uint8_t*>(heap_caps_malloc(tileSize * tileSize * sizeof(uint8_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+            if (!tile.color || (binner.alpha && !tile.alpha) || (binner.depth && !tile.depth) || (binner.stencil && !tile.stencil))
+                ESP_LOGE(LIBRARY_NAME, "No internal RAM for tiles, binned triangles are drawn into the frame buffer");
+            binner.tiles.push_back(tile);
+        }
+    }
+    void binTriangle(const TriangleSetup& setup)
+    {
+        initBins();
+        const DrawState& state = binner.states.back();
+        const int16_t minX = max(setup.minX, state.clipMinX);
+        const int16_t minY = max(setup.minY, state.clipMinY);
+        const int16_t maxX = min(setup.maxX, state.clipMaxX);
+        const int16_t maxY = min(setup.maxY, state.clipMaxY);
+        if (minX > maxX || minY > maxY)
+            return;
+        const uint32_t index = binner.triangles.size();
+        binner.triangles.push_back({ setup, static_cast<uint16_t>(binner.states.size() - 1) });
+        for (int16_t ty = minY / tileSize; ty <= maxY / tileSize; ty++)
+            for (int16_t tx = minX / tileSize; tx <= maxX / tileSize; tx++)
+                binner.bins[ty * binner.tilesX + tx].push_back(index);
+    }
+    void resolveTile(uint16_t tileIndex, const TileMemory& tile, TexelCache* texelCache)
+    {
+        const RenderTarget& frame = binner.frame;
+        const uint16_t tx = tileIndex % binner.tilesX;
+        const uint16_t ty = tileIndex / binner.tilesX;
+        const bool direct = !tile.color || (frame.alpha && !tile.alpha) || (frame.depth && !tile.depth) || (frame.stencil && !tile.stencil);
+        const bool depth = frame.depth && (binner.usesDepth || binner.pendingDepthClear);
+        const bool stencil = frame.stencil && binner.usesStencil;
+        RenderTarget target = frame;
+        target.texelCache = texelCache;
+        if (!direct)
+        {
+            target.color = tile.color;
+            target.alpha = frame.alpha ? tile.alpha : nullptr;
+            target.depth = depth ? tile.depth : nullptr;
+            target.stencil = stencil ? tile.stencil : nullptr;
+            target.stride = tileSize;
+            target.originX = tx * tileSize;
+            target.originY = ty * tileSize;
+        }
+        target.minX = tx * tileSize;
+        target.minY = ty * tileSize;
+        target.maxX = min<int16_t>(target.minX + tileSize, context->width) - 1;
+        target.maxY = min<int16_t>(target.minY + tileSize, context->height) - 1;
+        const int16_t width = target.maxX - target.minX + 1;
+
+        for (int16_t row = target.minY; row <= target.maxY; row++)
+        {
+            const uint32_t src = row * frame.stride + target.minX;
+            const uint32_t dst = (row - target.originY) * target.stride + target.minX - target.originX;
+            if (binner.pendingClear)
+            {
+                std::fill_n(target.color + dst, width, binner.clearColor);
+                if (target.alpha)
+                    std::fill_n(target.alpha + dst, width, binner.clearAlpha);
+            }
+            else if (!direct)
+            {
+                memcpy(target.color + dst, frame.color + src, width * sizeof(uint16_t));
+                if (target.alpha)
+                    memcpy(target.alpha + dst, frame.alpha + src, width * sizeof(uint8_t));
+            }
+            if (depth && binner.pendingDepthClear)
+                std::fill_n(target.depth + dst, width, binner.clearDepth);
+            else if (depth && !direct)
+                memcpy(target.depth + dst, frame.depth + src, width * sizeof(uint16_t));
+            if (stencil && !direct)
+                memcpy(target.stencil + dst, frame.stencil + src, width * sizeof(uint8_t));
+        }
+        for (uint32_t index : binner.bins[tileIndex])
+        {
+            const BinnedTriangle& triangle = binner.triangles[index];
+            rasterize(triangle.setup, binner.states[triangle.state], target);
+        }
+        for (int16_t row = target.minY; !direct && row <= target.maxY; row++)
+        {
+            const uint32_t dst = row * frame.stride + target.minX;
+            const uint32_t src = (row - target.originY) * target.stride;
+            memcpy(frame.color + dst, target.color + src, width * sizeof(uint16_t));
+            if (target.alpha)
+                memcpy(frame.alpha + dst, target.alpha + src, width * sizeof(uint8_t));
+            if (depth)
+                memcpy(frame.depth + dst, target.depth + src, width * sizeof(uint16_t));
+            if (stencil)
+                memcpy(frame.stencil + dst, target.stencil + src, width * sizeof(uint8_t));
+        }
+    }
+    //tiles never overlap and keep their triangle order, so the result does not depend on which worker took which tile
+    void resolveTileJob(void* data, uint8_t worker)
+    {
+        const TileMemory& tile = binner.tiles[worker];
+        for (uint32_t i = binner.nextWork++; i < binner.work.size(); i = binner.nextWork++)
+            resolveTile(binner.work[i], tile, workerTexelCache(worker));
+    }
+    void resolveBins()
+    {
+        if (binner.triangles.empty() && !binner.pendingClear && !binner.pendingDepthClear)
+        {
+            //draws that binned nothing still leave their state
+            binner.states.clear();
+            return;
+        }
+        initBins();
+        initTileMemory();
+        if (context->glTexelCache)
+            initTexelCaches(scheduler.workerCount());
+        binner.frame = frameRenderTarget();
+        binner.work.clear();
+        for (uint16_t i = 0; i < binner.bins.size(); i++)
+            if (!binner.bins[i].empty() || binner.pendingClear || binner.pendingDepthClear)
+                binner.work.push_back(i);
+        binner.nextWork = 0;
+        if (scheduler.workerCount() > 1 && binner.work.size() > 1)
+            scheduler.run(resolveTileJob, nullptr);
+        else
+            resolveTileJob(nullptr, 0);
+        for (uint16_t i : binner.work)
+            binner.bins[i].clear();
+        binner.triangles.clear();
+        binner.states.clear();
+        binner.pendingClear = false;
+        binner.pendingDepthClear = false;
+        binner.usesDepth = false;
+        binner.usesStencil = false;
+    }
+    //the state every binned setup of one draw call refers to
+    void pushBinnedState(const DrawState& state)
+    {
+        //BinnedTriangle::state indexes at most 65536 draws per resolve
+        if (binner.states.size() == 65536)
+            resolveBins();
+        binner.states.push_back(state);
+        binner.usesDepth |= state.depthTest;
+        binner.usesStencil |= state.stencilTest;
+    }
+    //what one draw call did to the stencil buffer, for following the mask
+    struct StencilDraw
+    {
+        uint32_t setups = 0;
+        bool rect = false;
+        int16_t minX = 0, minY = 0, maxX = -1, maxY = -1;
+    };
+    StencilDraw stencilDraw;
+    void drawSetup(const TriangleSetup& setup, const DrawState& state, const RenderTarget& target)
+    {
+        if (state.stencilWrites)
+        {
+            stencilDraw.setups++;
+            stencilDraw.rect = setup.rect;
+            stencilDraw.minX = max(setup.minX, state.clipMinX);
+            stencilDraw.minY = max(setup.minY, state.clipMinY);
+            stencilDraw.maxX = min(setup.maxX, state.clipMaxX);
+            stencilDraw.maxY = min(setup.maxY, state.clipMaxY);
+        }
+        if (context->glTileBinning)
+            binTriangle(setup);
+        else
+            rasterize(setup, state, target);
+    }
+    void setupAndDrawTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const DrawState& state, const RenderTarget& target)
+    {
+        TriangleSetup setup;
+        if (setupTriangle(v0, v1, v2, setup))
+            drawSetup(setup, state, target);
+    }
+    void perspectiveDivide(Vertex& vertex)
+    {
+        if (vertex.pos[3] != 1.f)
+        {
+            GLfloat oneDivW = 1.f / vertex.pos[3];
+            vertex.pos[0] *= oneDivW;
+            vertex.pos[1] *= oneDivW;
+            vertex.pos[2] *= oneDivW;
+        }
+    }
+    Vertex lerpVertex(const Vertex& a, const Vertex& b, float t)
+    {
+        Vertex result;
+        for (int8_t i = 0; i < 4; i++)
+        {
+            result.pos[i] = a.pos[i] + (b.pos[i] - a.pos[i]) * t;
+            result.col[i] = a.col[i] + (b.col[i] - a.col[i]) * t;
+            result.tex[i] = a.tex[i] + (b.tex[i] - a.tex[i]) * t;
+        }
+        return result;
+    }
+    //planes a clip space vertex has to be inside of before the perspective divide,
+    //x and y only against the guard band so that most triangles never need clipping
+    enum ClipPlane : uint8_t
+    {
+        ClipW, ClipNear, ClipFar, ClipLeft, ClipRight, ClipBottom, ClipTop, ClipPlaneCount
+    };
+    //the rasterizer limit in normalized device coordinates of the current viewport, one pixel inside
+    //so rounding never pushes a clipped vertex past it
+    struct GuardBand
+    {
+        float left, right, bottom, top;
+    };
+    GuardBand viewportGuardBand()
+    {
+        const float halfWidth = context->glViewportWidth * 0.5f;
+        const float halfHeight = context->glViewportHeight * 0.5f;
+        //viewport centre relative to the screen centre, y up
+        const float centerX = context->glViewportX + halfWidth - context->width * 0.5f;
+        const float centerY = context->glViewportY + halfHeight - context->height * 0.5f;
+        const float limit = rasterGuardBand - 1.f;
+        return { (-limit - centerX) / halfWidth, (limit - centerX) / halfWidth, (-limit - centerY) / halfHeight, (limit - centerY) / halfHeight };
+    }
+    float clipDistance(const Vertex& vertex, uint8_t plane, const GuardBand& guard)
+    {
+        const float x = vertex.pos[0], y = vertex.pos[1], z = vertex.pos[2], w = vertex.pos[3];
+        switch (plane)
+        {
+        case ClipW: return w - clipMinW;
+        case ClipNear: return w + z;
+        case ClipFar: return w - z;
+        case ClipLeft: return -guard.left * w + x;
+        case ClipRight: return guard.right * w - x;
+        case ClipBottom: return -guard.bottom * w + y;
+        case ClipTop: return guard.top * w - y;
+        default: return 0.f;
+        }
+    }
+    uint8_t viewVolumeOutcode(const Vertex& vertex)
+    {
+        const float x = vertex.pos[0], y = vertex.pos[1], z = vertex.pos[2], w = vertex.pos[3];
+        return (x < -w) | (x > w) << 1 | (y < -w) << 2 | (y > w) << 3 | (z < -w) << 4 | (z > w) << 5;
+    }
+    void drawTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const DrawState& state, const RenderTarget& target)
+    {
+        //all three vertices outside the same view volume plane, nothing can be visible
+        if (viewVolumeOutcode(v0) & viewVolumeOutcode(v1) & viewVolumeOutcode(v2))
+            return;
+
+        const GuardBand guard = viewportGuardBand();
+        uint8_t clipMask = 0;
+        for (uint8_t plane = 0; plane < ClipPlaneCount; plane++)
+            if (clipDistance(v0, plane, guard) < 0.f || clipDistance(v1, plane, guard) < 0.f || clipDistance(v2, plane, guard) < 0.f)
+                clipMask |= 1 << plane;
+
+        if (!clipMask)
+        {
+            Vertex t0 = v0, t1 = v1, t2 = v2;
+            perspectiveDivide(t0);
+            perspectiveDivide(t1);
+            perspectiveDivide(t2);
+            setupAndDrawTriangle(t0, t1, t2, state, target);
+            return;
+        }
+
+        //Sutherland-Hodgman, only against the planes that are actually crossed
+        Vertex polygon[2][3 + ClipPlaneCount];
+        uint8_t count = 3;
+        uint8_t current = 0;
+        polygon[0][0] = v0;
+        polygon[0][1] = v1;
+        polygon[0][2] = v2;
+        for (uint8_t plane = 0; plane < ClipPlaneCount; plane++)
+        {
+            if (!(clipMask & 1 << plane))
+                continue;
+            const Vertex* in = polygon[current];
+            Vertex* out = polygon[current ^ 1];
+            uint8_t outCount = 0;
+            for (uint8_t i = 0; i < count; i++)
+            {
+                const Vertex& a = in[i];
+                const Vertex& b = in[(i + 1) % count];
+                const float da = clipDistance(a, plane, guard);
+                const float db = clipDistance(b, plane, guard);
+                if (da >= 0.f)
+                    out[outCount++] = a;
+                if ((da >= 0.f) != (db >= 0.f))
+                    out[outCount++] = lerpVertex(a, b, da / (da - db));
+            }
+            count = outCount;
+            current ^= 1;
+            if (count < 3)
+                return;
+        }
+        Vertex* clipped = polygon[current];
+        for (uint8_t i = 0; i < count; i++)
+            perspectiveDivide(clipped[i]);
+        for (uint8_t i = 1; i + 1 < count; i++)
+            setupAndDrawTriangle(clipped[0], clipped[i], clipped[i + 1], state, target);
+    }
+    //holds back one triangle of a draw so that two forming a screen aligned rectangle can be filled together
+    struct RectPairing
+    {
+        Vertex pending[3];
+        bool hasPending = false;
+    };
+    void flushTriangle(RectPairing& pairing, const DrawState& state, const RenderTarget& target)
+    {
+        if (pairing.hasPending)
+            drawTriangle(pairing.pending[0], pairing.pending[1], pairing.pending[2], state, target);
+        pairing.hasPending = false;
+    }
+    void submitTriangle(RectPairing& pairing, const Vertex& v0, const Vertex& v1, const Vertex& v2, const DrawState& state, const RenderTarget& target)
+    {
+        //only untransformed 2D geometry can pair up
+        if (v0.pos[3] != 1.f || v1.pos[3] != 1.f || v2.pos[3] != 1.f)
+        {
+            flushTriangle(pairing, state, target);
+            drawTriangle(v0, v1, v2, state, target);
+            return;
+        }
+        if (pairing.hasPending)
+        {
+            const Vertex* a[3] = { &pairing.pending[0], &pairing.pending[1], &pairing.pending[2] };
+            const Vertex* b[3] = { &v0, &v1, &v2 };
+            TriangleSetup setup;
+            bool visible;
+            if (setupRect(a, b, setup, visible))
+            {
+                if (visible)
+                    drawSetup(setup, state, target);
+                pairing.hasPending = false;
+                return;
+            }
+            flushTriangle(pairing, state, target);
+        }
+        pairing.pending[0] = v0;
+        pairing.pending[1] = v1;
+        pairing.pending[2] = v2;
+        pairing.hasPending = true;
+    }
+    void drawLine(const Vertex& v0, const Vertex& v1, const DrawState& state, const RenderTarget& target)
+    {
+        //only w and depth are clipped in clip space, x and y are cut at the clip rectangle after the divide
+        const GuardBand guard = viewportGuardBand();
+        Vertex a = v0, b = v1;
+        bool endClipped = false;
+        for (uint8_t plane = ClipW; plane <= ClipFar; plane++)
+        {
+            const float da = clipDistance(a, plane, guard);
+            const float db = clipDistance(b, plane, guard);
+            if (da < 0.f && db < 0.f)
+                return;
+            if (da < 0.f)
+                a = lerpVertex(a, b, da / (da - db));
+            else if (db < 0.f)
+            {
+                b = lerpVertex(a, b, da / (da - db));
+                endClipped = true;
+            }
+        }
+        perspectiveDivide(a);
+        perspectiveDivide(b);
+
+        const float halfWidth = context->glViewportWidth * 0.5f;
+        const float halfHeight = context->glViewportHeight * 0.5f;
+        const float ax = a.pos[0] * halfWidth + (context->glViewportX + halfWidth);
+        const float ay = -a.pos[1] * halfHeight + (context->height - context->glViewportY - halfHeight);
+        const float bx = b.pos[0] * halfWidth + (context->glViewportX + halfWidth);
+        const float by = -b.pos[1] * halfHeight + (context->height - context->glViewportY - halfHeight);
+
+        //Cohen-Sutherland against the clip rectangle, t holds where the visible part starts and ends on a -> b
+        const float left = state.clipMinX, right = state.clipMaxX + 0.99f;
+        const float top = state.clipMinY, bottom = state.clipMaxY + 0.99f;
+        auto outcode = [&](float x, float y) -> uint8_t
+        {
+            return (x < left) | (x > right) << 1 | (y < top) << 2 | (y > bottom) << 3;
+        };
+        float x[2] = { ax, bx }, y[2] = { ay, by }, t[2] = { 0.f, 1.f };
+        uint8_t code[2] = { outcode(ax, ay), outcode(bx, by) };
+        //every endpoint is moved at most once per side, the bound only guards against rounding ping-pong
+        for (uint8_t pass = 0; (code[0] | code[1]) && pass < 8; pass++)
+        {
+            if (code[0] & code[1])
+                return;
+            const uint8_t i = code[0] ? 0 : 1;
+            if (code[i] & 3)
+            {
+                x[i] = code[i] & 1 ? left : right;
+                t[i] = (x[i] - ax) / (bx - ax);
+                y[i] = ay + (by - ay) * t[i];
+            }
+            else
+            {
+                y[i] = code[i] & 4 ? top : bottom;
+                t[i] = (y[i] - ay) / (by - ay);
+                x[i] = ax + (bx - ax) * t[i];
+            }
+            code[i] = outcode(x[i], y[i]);
+        }
+        if (t[1] < 1.f)
+            endClipped = true;
+
+        const int32_t x0 = std::clamp<int32_t>(floorf(x[0]), state.clipMinX, state.clipMaxX);
+        const int32_t y0 = std::clamp<int32_t>(floorf(y[0]), state.clipMinY, state.clipMaxY);
+        const int32_t x1 = std::clamp<int32_t>(floorf(x[1]), state.clipMinX, state.clipMaxX);
+        const int32_t y1 = std::clamp<int32_t>(floorf(y[1]), state.clipMinY, state.clipMaxY);
+        const int32_t dx = abs(x1 - x0);
+        const int32_t dy = abs(y1 - y0);
+        const int32_t steps = max(dx, dy);
+        //the last pixel belongs to the next segment of a strip, unless the line was cut before it
+        const int32_t count = endClipped ? steps + 1 : steps;
+        if (count == 0)
+            return;
+
+        Interpolants in = vertexInterpolants(lerpVertex(a, b, t[0]));
+        Interpolants step = {};
+        if (steps)
+        {
+            const Interpolants end = vertexInterpolants(lerpVertex(a, b, t[1]));
+            step.s = (end.s - in.s) / steps;
+            step.t = (end.t - in.t) / steps;
+            step.r = (end.r - in.r) / steps;
+            step.g = (end.g - in.g) / steps;
+            step.b = (end.b - in.b) / steps;
+            step.a = (end.a - in.a) / steps;
+            step.z = static_cast<int32_t>(end.z - in.z) / steps;
+        }
+        const int32_t stepX = x0 < x1 ? 1 : -1;
+        const int32_t stepY = y0 < y1 ? 1 : -1;
+        int32_t px = x0, py = y0;
+        if (dx >= dy)
+        {
+            //the pixels a row keeps are one span for the kernel, which always walks to the right
+            Interpolants back = {};
+            advanceInterpolants(back, step, -1);
+            int32_t error = 2 * dy - dx;
+            int32_t spanStart = 0;
+            Interpolants spanIn = in;
+            for (int32_t i = 0; i < count; i++)
+            {
+                if (i + 1 == count || error > 0)
+                {
+                    const int32_t length = i - spanStart + 1;
+                    Interpolants first = spanIn;
+                    if (stepX < 0)
+                        advanceInterpolants(first, step, length - 1);
+                    const int32_t spanLeft = stepX < 0 ? px : px - length + 1;
+                    state.kernel(state, target, (py - target.originY) * target.stride + spanLeft - target.originX, first, stepX < 0 ? back : step, length);
+                    advanceInterpolants(spanIn, step, length);
+                    spanStart = i + 1;
+                }
+                px += stepX;
+                if (error > 0)
+                {
+                    py += stepY;
+                    error -= 2 * dx;
+                }
+                error += 2 * dy;
+            }
+        }
+        else
+        {
+            int32_t error = 2 * dx - dy;
+            for (int32_t i = 0; i < count; i++, stepInterpolants(in, step))
+            {
+                state.kernel(state, target, (py - target.originY) * target.stride + px - target.originX, in, step, 1);
+                py += stepY;
+                if (error > 0)
+                {
+                    px += stepX;
+                    error -= 2 * dy;
+                }
+                error += 2 * dx;
+            }
+        }
+        if (state.depthTest && state.depthWrite && !depthOnlyDecreases(state.depthFunc))
+            invalidateDepthMax(target, min(x0, x1), min(y0, y1), max(x0, x1), max(y0, y1));
+        if (state.stencilWrites)
+        {
+            stencilDraw.setups++;
+            stencilDraw.rect = false;
+        }
+    }
+    //a single rectangle drawn over a known uniform stencil buffer, every pixel of it went the same way through the stencil test
+    void updateStencilMask(const DrawState& state)
+    {
+        Context::StencilMask& mask = currentStencilMask();
+        if (!state.stencilWrites || stencilDraw.setups == 0)
+            return;
+        if (stencilDraw.setups == 1 && stencilDraw.rect && mask.known && mask.minX > mask.maxX && !state.alphaTest && !state.depthTest)
+        {
+            mask.inside = applyStencilOp(state, stencilPasses(state, mask.outside) ? state.stencilZPass : state.stencilFail, mask.outside);
+            mask.minX = stencilDraw.minX;
+            mask.minY = stencilDraw.minY;
+            mask.maxX = stencilDraw.maxX;
+            mask.maxY = stencilDraw.maxY;
+            if (mask.inside == mask.outside || mask.minX > mask.maxX || mask.minY > mask.maxY)
+                mask.maxX = -1;
+        }
+        else
+            mask.known = false;
+    }
+    //size in pixels of one point, from the size array if enabled and attenuated with its eye distance
+    float pointSize(const Vertex& vertex, uint32_t sizeTotalOffset)
+    {
+        float size = context->glPointSize;
+        if (context->glUsePointSizeArray)
+        {
+            const GLubyte* data = (const GLubyte*)context->glPointSizePointer + sizeTotalOffset;
+            size = context->glPointSizePointerType == GL_FIXED ? *(const GLfixed*)data * oneDiv65536 : *(const GLfloat*)data;
+        }
+        const GLfloat* attenuation = context->glPointDistanceAttenuation;
+        if (attenuation[0] != 1.f || attenuation[1] != 0.f || attenuation[2] != 0.f)
+        {
+            GLfloat eye[4];
+            multiplyMatrixVector(context->glModelViewMatrix.back(), vertex.pos, eye);
+            const float distance = sqrtf(eye[0] * eye[0] + eye[1] * eye[1] + eye[2] * eye[2]);
+            size *= sqrtf(1.f / (attenuation[0] + attenuation[1] * distance + attenuation[2] * distance * distance));
+        }
+        return std::clamp(std::clamp(size, context->glPointSizeMin, context->glPointSizeMax), 1.f, static_cast<float>(glGetMaxPointSize));
+    }
+    //glDrawTexOES, the crop rectangle of the texture scaled onto a window rectangle with its lower left corner at x, y
+    void drawTexture(float x, float y, float z, float width, float height)
+    {
+        if (width <= 0.f || height <= 0.f)
+        {
+            lastError = GL_INVALID_VALUE;
+            return;
+        }
+        //pixel centres inside [x, x + width) x [top, top + height) with rows counted from the top
+        const float top = context->height - y - height;
+        TriangleSetup setup;
+        setup.minX = max<int32_t>(0, ceilf(x - 0.5f));
+        setup.maxX = min<int32_t>(context->width - 1, ceilf(x + width - 0.5f) - 1);
+        setup.minY = max<int32_t>(0, ceilf(top - 0.5f));
+        setup.maxY = min<int32_t>(context->height - 1, ceilf(top + height - 0.5f) - 1);
+        if (setup.minX > setup.maxX || setup.minY > setup.maxY)
+            return;
+
+        const DrawState state = captureDrawState(SourceDrawTex);
+        setup.value = {};
+        setup.dx = {};
+        setup.dy = {};
+        setup.value.r = setup.value.g = setup.value.b = setup.value.a = 255 << 16;
+        const float depth = context->glDepthRangeNear + std::clamp(z, 0.f, 1.f) * (context->glDepthRangeFar - context->glDepthRangeNear);
+        setup.value.z = floatToDepth(depth);
+        setup.z = setup.value.z;
+        if (state.texture)
+        {
+            //s runs over the crop width from the left edge, t over the crop height from the bottom edge
+            const Context::Texture& tex = *state.texture;
+            const float ds = tex.cropRect[2] / (width * tex.width);
+            const float dt = tex.cropRect[3] / (height * tex.height);
+            setup.value.s = floatToTexCoord(static_cast<float>(tex.cropRect[0]) / tex.width + (setup.minX + 0.5f - x) * ds);
+            setup.value.t = floatToTexCoord(static_cast<float>(tex.cropRect[1] + tex.cropRect[3]) / tex.height - (setup.minY + 0.5f - top) * dt);
+            setup.dx.s = floatToTexCoord(ds);
+            setup.dy.t = floatToTexCoord(-dt);
         }
+        setup.rect = true;
+
+        if (context->glTileBinning)
+            pushBinnedState(state);
+        stencilDraw = StencilDraw();
+        drawSetup(setup, state, frameRenderTarget());
+        updateStencilMask(state);
     }
-    void getVertexAtOffset(uint32_t vertexTotalOffset, uint32_t colorTotalOffset, uint32_t texCoordTotalOffset, Vertex* vertex)
+    //the storage glTexImage2D keeps a format and type combination in, false and lastError set if they do not go together
+    bool textureStorage(GLenum format, GLenum type, Context::Texture::Storage& storage)
     {
-        const GLubyte* vertices = (const GLubyte*)context->glVertexPointer + vertexTotalOffset;
-        const GLubyte* colors = (const GLubyte*)context->glColorPointer + colorTotalOffset;
-        const GLubyte* texCoord = (const GLubyte*)context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointer + texCoordTotalOffset;
-
-        for (uint8_t j = 0; j < context->glVertexPointerSize; j++)
+        if (format != GL_RGBA && format != GL_RGB && format != GL_ALPHA && format != GL_LUMINANCE && format != GL_LUMINANCE_ALPHA)
         {
-            if (context->glVertexPointerType == GL_FLOAT)
-                vertex->pos[j] = ((GLfloat*)vertices)[j];
-            else if (context->glVertexPointerType == GL_SHORT)
-                vertex->pos[j] = ((GLshort*)vertices)[j];
+            lastError = GL_INVALID_ENUM;
+            return false;
         }
-        if (context->glUseColorArray)
-            for (uint8_t j = 0; j < context->glColorPointerSize; j++)
-            {
-                if (context->glColorPointerType == GL_FLOAT)
-                    vertex->col[j] = ((GLfloat*)colors)[j];
-                else if (context->glColorPointerType == GL_SHORT)
-                    vertex->col[j] = ((GLshort*)colors)[j];
-                else if (context->glColorPointerType == GL_UNSIGNED_SHORT)
-                    vertex->col[j] = ((GLushort*)colors)[j];
-                else if (context->glColorPointerType == GL_BYTE)
-                    vertex->col[j] = ((GLbyte*)colors)[j];
-                else if (context->glColorPointerType == GL_UNSIGNED_BYTE)
-                    vertex->col[j] = ((GLubyte*)colors)[j] * oneDiv255;
-            }
-        if (context->glTextureUnit[context->glClientActiveTexture].glUseTexCoordArray)
-            for (uint8_t j = 0; j < context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointerSize; j++)
+        switch (type)
+        {
+        case GL_UNSIGNED_BYTE:
+            switch (format)
             {
-                if (context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointerType == GL_FLOAT)
-                    vertex->tex[j] = ((GLfloat*)texCoord)[j];
-                else if (context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointerType == GL_SHORT)
-                    vertex->tex[j] = ((GLshort*)texCoord)[j];
+            case GL_RGBA: storage = Context::Texture::RGBA8888; return true;
+            case GL_RGB: storage = Context::Texture::RGB888; return true;
+            case GL_ALPHA: storage = Context::Texture::Alpha8; return true;
+            case GL_LUMINANCE: storage = Context::Texture::Luminance8; return true;
+            default: storage = Context::Texture::LuminanceAlpha88; return true;
             }
+        case GL_UNSIGNED_SHORT_5_6_5: storage = Context::Texture::RGB565; break;
+        case GL_UNSIGNED_SHORT_4_4_4_4: storage = Context::Texture::RGBA4444; break;
+        case GL_UNSIGNED_SHORT_5_5_5_1: storage = Context::Texture::RGBA5551; break;
+        default:
+            lastError = GL_INVALID_ENUM;
+            return false;
+        }
+        if (format != (type == GL_UNSIGNED_SHORT_5_6_5 ? GL_RGB : GL_RGBA))
+        {
+            lastError = GL_INVALID_OPERATION;
+            return false;
+        }
+        return true;
     }
-    float blendFactorCalc(GLenum factor, const float src[4], const float dst[4], uint8_t component)
+    //the storage of a compressed format and for paletted ones the storage and count of the palette entries,
+    //false and lastError set if it is none of the supported ones
+    bool compressedTextureStorage(GLenum internalformat, Context::Texture::Storage& storage, Context::Texture::Storage& entry, uint16_t& entries)
     {
-        switch (factor)
+        static constexpr Context::Texture::Storage entryStorage[5] = { Context::Texture::RGB888, Context::Texture::RGBA8888,
+            Context::Texture::RGB565, Context::Texture::RGBA4444, Context::Texture::RGBA5551 };
+        if (internalformat == GL_ETC1_RGB8_OES)
         {
-        case GL_ZERO: return 0.f;
-        case GL_ONE: return 1.f;
-        case GL_SRC_COLOR: return src[component];
-        case GL_ONE_MINUS_SRC_COLOR: return 1.f - src[component];
-        case GL_DST_COLOR: return dst[component];
-        case GL_ONE_MINUS_DST_COLOR: return 1.f - dst[component];
-        case GL_SRC_ALPHA: return src[3];
-        case GL_ONE_MINUS_SRC_ALPHA: return 1.f - src[3];
-        case GL_DST_ALPHA: return dst[3];
-        case GL_ONE_MINUS_DST_ALPHA: return 1.f - dst[3];
-        case GL_SRC_ALPHA_SATURATE:
-            if (component == 3)
-                return 1.f;
-            return min(src[3], 1.f - dst[3]);
-        default:
-            return 1.f;
+            storage = Context::Texture::ETC1;
+            entry = Context::Texture::RGBA8888;
+            entries = 0;
+            return true;
         }
+        if (internalformat < GL_PALETTE4_RGB8_OES || internalformat > GL_PALETTE8_RGB5_A1_OES)
+        {
+            lastError = GL_INVALID_ENUM;
+            return false;
+        }
+        const bool palette8 = internalformat >= GL_PALETTE8_RGB8_OES;
+        storage = palette8 ? Context::Texture::Palette8 : Context::Texture::Palette4;
+        entry = entryStorage[internalformat - (palette8 ? GL_PALETTE8_RGB8_OES : GL_PALETTE4_RGB8_OES)];
+        entries = palette8 ? 256 : 16;
+        return true;
     }
-    void vertexShader(Vertex& targetVertex, const std::array<float, 16>& mvpMatrix)
+    //level 0 is the texture itself, nullptr for levels not specified by glTexImage2D
+    Context::Texture* textureLevel(Context::Texture& tex, GLint level)
     {
-        //Now transform
-        GLfloat temp[4];
-        // ESP_LOGE("Pos", "%f %f %f %f", targetVertex.pos[0], targetVertex.pos[1], targetVertex.pos[2], targetVertex.pos[3]);
-        multiplyMatrixVector(mvpMatrix, targetVertex.pos, temp);
-        if (temp[3] != 1.f)
+        if (level == 0)
+            return &tex;
+        if (level > static_cast<GLint>(tex.mipmaps.size()) || !tex.mipmaps[level - 1].data)
+            return nullptr;
+        return &tex.mipmaps[level - 1];
+    }
+    //keeps the storage of a level if the size stays, the caller resolves the bins still sampling it
+    void allocateLevel(Context::Texture& level, uint16_t width, uint16_t height, uint16_t format, Context::Texture::Storage storage, bool tiled)
+    {
+        if (level.data && levelSize(level.width, level.height, level.storage, level.tiled) != levelSize(width, height, storage, tiled))
         {
-            GLfloat oneDivW = 1.f / temp[3];
-            temp[0] *= oneDivW;
-            temp[1] *= oneDivW;
-            temp[2] *= oneDivW;
+            heap_caps_free(level.data);
+            level.data = nullptr;
         }
-        memcpy(targetVertex.pos, temp, 4 * sizeof(GLfloat));
-
-        multiplyMatrixVector(context->glTextureUnit[context->glActiveTexture].glTextureMatrix.back(), targetVertex.tex, temp);
-        memcpy(targetVertex.tex, temp, 4 * sizeof(GLfloat));
+        level.width = width;
+        level.height = height;
+        level.internalformat = format;
+        level.storage = storage;
+        level.tiled = tiled;
+        if (!level.data)
+            level.data = heap_caps_malloc(max<uint32_t>(levelSize(width, height, storage, tiled), 1), MALLOC_CAP_SPIRAM);
+        invalidateTexelCaches();
     }
-
-    int16_t fragmentShader(const Vertex& v0, const Vertex& v1, const Vertex& v2,
-        float weight0, float weight1, float weight2, bool sameColor, uint16_t dstColor, uint8_t dstAlpha, bool& discard, uint8_t& returnAlpha)
+    //the storage a texture with GL_TEXTURE_STORAGE_TYPE_ESP type keeps uploads of the given storage in
+    Context::Texture::Storage convertedStorage(Context::Texture::Storage upload, uint16_t type)
     {
-        float src[4] = { 1.f, 1.f, 1.f, 1.f };
-        Context::Texture& tex = context->glTextures[context->glTextureUnit[context->glActiveTexture].glBoundTexture];
-        if (context->glTextureUnit[context->glClientActiveTexture].glUseTexCoordArray && tex.data)
-        {
-            float texCoord[4];
-            for (int8_t i = 0; i < context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointerSize; i++)
-                texCoord[i] = v0.tex[i] * weight0 + v1.tex[i] * weight1 + v2.tex[i] * weight2;
-            for (int8_t i = 0; i < 4; i++)
-                texCoord[i] = std::clamp(texCoord[i], 0.f, 1.f);
-            int16_t posX = texCoord[0] * tex.width;
-            int16_t posY = texCoord[1] * tex.height;
-            if (posX == tex.width)
-                posX--;
-            if (posY == tex.height)
-                posY--;
-            Context::Texture::RGBA targetPixel = ((Context::Texture::RGBA*)tex.data)[posY * tex.width + posX];
-            src[0] *= targetPixel.r * oneDiv255;
-            src[1] *= targetPixel.g * oneDiv255;
-            src[2] *= targetPixel.b * oneDiv255;
-            src[3] *= targetPixel.a * oneDiv255;
+        if (upload == Context::Texture::RGB888 && type == GL_UNSIGNED_SHORT_5_6_5)
+            return Context::Texture::RGB565;
+        if (upload == Context::Texture::RGBA8888 && type == GL_UNSIGNED_SHORT_4_4_4_4)
+            return Context::Texture::RGBA4444;
+        if (upload == Context::Texture::RGBA8888 && type == GL_UNSIGNED_SHORT_5_5_5_1)
+            return Context::Texture::RGBA5551;
+        return upload;
+    }
+    //count texels from one storage to another, a plain copy if they are the same, otherwise one of the conversions
+    //convertedStorage allows, reading RGBA texels a word at a time and writing two 16 bit texels per store
+    void convertTexels(Context::Texture::Storage from, Context::Texture::Storage to, const uint8_t* src, uint8_t* dst, uint32_t count)
+    {
+        if (from == to)
+        {
+            memcpy(dst, src, count * texelSize(to));
+            return;
         }
-        if (context->glUseColorArray)
+        const uint8_t srcSize = texelSize(from);
+        auto pack = [to](const uint8_t* texel) -> uint32_t
         {
-            if (!sameColor)
+            //3 byte texels straight from their bytes, assembling a word from them costs more than the conversion
+            if (to == Context::Texture::RGB565)
+                return RGBto565(texel[0], texel[1], texel[2]);
+            uint32_t rgba;
+            memcpy(&rgba, texel, 4);
+            switch (to)
             {
-                for (uint8_t i = 0; i < 4; i++)
-                    src[i] *= v0.col[i] * weight0 + v1.col[i] * weight1 + v2.col[i] * weight2;
+            case Context::Texture::RGBA4444: return (rgba << 8 & 0xF000) | (rgba >> 4 & 0x0F00) | (rgba >> 16 & 0x00F0) | rgba >> 28;
+            default: return (rgba << 8 & 0xF800) | (rgba >> 5 & 0x07C0) | (rgba >> 18 & 0x003E) | rgba >> 31;
             }
-            else
+        };
+        uint32_t i = 0;
+        //16 bit texels pairs as one aligned word, the first one in the low half on the little endian Xtensa
+        if (reinterpret_cast<uintptr_t>(dst) & 2)
+        {
+            *reinterpret_cast<uint16_t*>(dst) = pack(src);
+            i++;
+        }
+        for (; i + 1 < count; i += 2)
+            *reinterpret_cast<uint32_t*>(dst + i * 2) = pack(src + i * srcSize) | pack(src + (i + 1) * srcSize) << 16;
+        if (i < count)
+            *reinterpret_cast<uint16_t*>(dst + i * 2) = pack(src + i * srcSize);
+    }
+    //bytes from one row of an upload to the next, rows start GL_UNPACK_ALIGNMENT aligned
+    uint32_t uploadStride(uint16_t width, Context::Texture::Storage upload)
+    {
+        return (width * texelSize(upload) + context->glUnpackAlignment - 1) & ~(context->glUnpackAlignment - 1);
+    }
+    //copies rows of texels of the upload storage stride bytes apart into the rectangle at x, y of the level,
+    //one conversion per row or per block row of a tiled level, touches nothing but the data of level
+    void copyTexels(const Context::Texture& level, uint16_t x, uint16_t y, uint16_t width, uint16_t height, const void* pixels,
+        Context::Texture::Storage upload, uint32_t stride)
+    {
+        constexpr uint32_t mask = (1 << textureTileShift) - 1;
+        const uint8_t srcSize = texelSize(upload);
+        const uint8_t dstSize = texelSize(level.storage);
+        const uint8_t* src = static_cast<const uint8_t*>(pixels);
+        uint8_t* dst = static_cast<uint8_t*>(level.data);
+        for (uint16_t j = 0; j < height; j++, src += stride)
+        {
+            if (!level.tiled)
+            {
+                convertTexels(upload, level.storage, src, dst + texelIndex<false>(level, x, y + j) * dstSize, width);
+                continue;
+            }
+            for (uint16_t i = 0; i < width;)
             {
-                for (uint8_t i = 0; i < 4; i++)
-                    src[i] *= v0.col[i];
+                const uint16_t run = min<uint16_t>(mask + 1 - ((x + i) & mask), width - i);
+                convertTexels(upload, level.storage, src + i * srcSize, dst + texelIndex<true>(level, x + i, y + j) * dstSize, run);
+                i += run;
             }
         }
-        if (context->glAlphaTest)
+    }
+    void writeTexels(Context::Texture& level, uint16_t x, uint16_t y, uint16_t width, uint16_t height, const void* pixels, Context::Texture::Storage upload)
+    {
+        invalidateTexelCaches();
+        copyTexels(level, x, y, width, height, pixels, upload, uploadStride(width, upload));
+    }
+    //the data and layout of a level without its mipmap chain or palette, what texelIndex and the texel writers read
+    Context::Texture levelLayout(const Context::Texture& level)
+    {
+        Context::Texture layout;
+        layout.data = level.data;
+        layout.width = level.width;
+        layout.height = level.height;
+        layout.internalformat = level.internalformat;
+        layout.storage = level.storage;
+        layout.tiled = level.tiled;
+        return layout;
+    }
+    //moves every specified level between the row major and the tiled layout, the caller resolves the bins still sampling it
+    //every new level is allocated before any texel moves, false and the texture as it was if one of them does not fit
+    bool setTextureTiled(Context::Texture& tex, bool tiled)
+    {
+        if (tex.tiled == tiled)
+            return true;
+        std::vector<Context::Texture> moved(tex.mipmaps.size() + 1);
+        for (size_t i = 0; i <= tex.mipmaps.size(); i++)
         {
-            switch (context->glAlphaFunc)
+            const Context::Texture& level = i == 0 ? tex : tex.mipmaps[i - 1];
+            //compressed levels keep their own block layout, the flag still applies once they are redefined uncompressed
+            if (!level.data || compressedStorage(level.storage))
+                continue;
+            allocateLevel(moved[i], level.width, level.height, level.internalformat, level.storage, tiled);
+            if (!moved[i].data)
             {
-            case GL_NEVER: discard = true; return 0;
-            case GL_LESS: if (!(src[3] < context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_LEQUAL: if (!(src[3] <= context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_EQUAL: if (!(src[3] == context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_GREATER: if (!(src[3] > context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_NOTEQUAL: if (!(src[3] != context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_GEQUAL: if (!(src[3] >= context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_ALWAYS:
-                break;
+                for (const Context::Texture& layout : moved)
+                    if (layout.data)
+                        heap_caps_free(layout.data);
+                return false;
             }
         }
-        /*if (context->glStencilTest)
+        for (size_t i = 0; i <= tex.mipmaps.size(); i++)
         {
-            switch (context->glStencilFunc)
+            Context::Texture& level = i == 0 ? tex : tex.mipmaps[i - 1];
+            if (moved[i].data)
             {
-            case GL_NEVER: discard = true; return 0;
-            case GL_LESS: if (!(src[3] < context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_LEQUAL: if (!(src[3] <= context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_EQUAL: if (!(src[3] == context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_GREATER: if (!(src[3] > context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_NOTEQUAL: if (!(src[3] != context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_GEQUAL: if (!(src[3] >= context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_ALWAYS:
-                break;
+                const uint8_t size = texelSize(level.storage);
+                for (uint16_t y = 0; y < level.height; y++)
+                    for (uint16_t x = 0; x < level.width; x++)
+                        memcpy(static_cast<uint8_t*>(moved[i].data) + texelIndex(moved[i], x, y) * size,
+                            static_cast<const uint8_t*>(level.data) + texelIndex(level, x, y) * size, size);
+                heap_caps_free(level.data);
+                level.data = moved[i].data;
             }
-        }*/
-        /*if (context->glDepthTest)
+            level.tiled = tiled;
+        }
+        return true;
+    }
+    void freeTexture(Context::Texture& tex)
+    {
+        for (Context::Texture& level : tex.mipmaps)
+            if (level.data)
+                heap_caps_free(level.data);
+        tex.mipmaps.clear();
+        if (tex.data)
+            heap_caps_free(tex.data);
+        tex.data = nullptr;
+        if (tex.palette)
+            heap_caps_free(tex.palette);
+        tex.palette = nullptr;
+        invalidateTexelCaches();
+    }
+    //level 0 redefined with storage other than Palette4 or Palette8 no longer needs the palette its mipmaps shared
+    void freePalette(Context::Texture& tex)
+    {
+        if (!tex.palette)
+            return;
+        heap_caps_free(tex.palette);
+        tex.palette = nullptr;
+        for (Context::Texture& level : tex.mipmaps)
+            level.palette = nullptr;
+    }
+    //storage for the whole chain down to 1x1 below level 0
+    void allocateMipmaps(Context::Texture& tex)
+    {
+        uint8_t levels = 0;
+        while (max(tex.width, tex.height) >> (levels + 1))
+            levels++;
+        for (size_t i = levels; i < tex.mipmaps.size(); i++)
+            if (tex.mipmaps[i].data)
+                heap_caps_free(tex.mipmaps[i].data);
+        tex.mipmaps.resize(levels);
+        const Context::Texture* source = &tex;
+        for (Context::Texture& level : tex.mipmaps)
         {
-            switch (context->glDepthFunc)
+            allocateLevel(level, max(source->width >> 1, 1), max(source->height >> 1, 1), tex.internalformat, tex.storage, tex.tiled);
+            source = &level;
+        }
+    }
+    //every texel of level the mean of the 2x2 block of source above it, touches nothing but the data of level
+    void downsampleLevel(const Context::Texture& source, const Context::Texture& level)
+    {
+        //a source side of 1 is not halved, both taps of the box fall on the same texel
+        const uint16_t stepX = source.width > 1 ? 1 : 0;
+        const uint16_t stepY = source.height > 1 ? 1 : 0;
+        for (uint16_t y = 0; y < level.height; y++)
+            for (uint16_t x = 0; x < level.width; x++)
             {
-            case GL_NEVER: discard = true; return 0;
-            case GL_LESS: if (!(src[3] < context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_LEQUAL: if (!(src[3] <= context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_EQUAL: if (!(src[3] == context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_GREATER: if (!(src[3] > context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_NOTEQUAL: if (!(src[3] != context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_GEQUAL: if (!(src[3] >= context->glAlphaRef)) { discard = true; return 0; } break;
-            case GL_ALWAYS:
-                break;
+                const uint16_t sx = x * 2 * stepX, sy = y * 2 * stepY;
+                const uint32_t texels[4] = { loadTexel(source, sx, sy), loadTexel(source, sx + stepX, sy),
+                    loadTexel(source, sx, sy + stepY), loadTexel(source, sx + stepX, sy + stepY) };
+                uint8_t mean[4];
+                for (uint8_t c = 0; c < 4; c++)
+                    mean[c] = ((texels[0] >> c * 8 & 0xFF) + (texels[1] >> c * 8 & 0xFF) + (texels[2] >> c * 8 & 0xFF) + (texels[3] >> c * 8 & 0xFF) + 2) >> 2;
+                storeTexel(level.storage, level.data, texelIndex(level, x, y), mean);
             }
-        }*/
-        if (context->glBlend)
-        {
-            float dst[4];
-            RGBFloatFrom565(dstColor, dst[0], dst[1], dst[2]);
-            dst[3] = dstAlpha * oneDiv255;
+    }
+    //the whole chain down to 1x1 from level 0, every texel the mean of the 2x2 block above it
+    void generateMipmaps(Context::Texture& tex)
+    {
+        if (!tex.data || compressedStorage(tex.storage))
+            return;
+        allocateMipmaps(tex);
+        for (size_t i = 0; i < tex.mipmaps.size(); i++)
+            downsampleLevel(i == 0 ? tex : tex.mipmaps[i - 1], tex.mipmaps[i]);
+    }
 
-            float result[4];
-            for (uint8_t i = 0; i < 3; i++)
-            {
-                const float sf = blendFactorCalc(context->glBlendColorSrc, src, dst, i);
-                const float df = blendFactorCalc(context->glBlendColorDst, src, dst, i);
+    //one glTexImage2DAsyncESP call, filled in and allocated on the calling thread, written by the background task
+    struct TextureUpload
+    {
+        Context::Texture* texture;
+        //the level written first, followed by the mipmaps generated from it
+        std::vector<Context::Texture> levels;
+        const uint8_t* data;
+        uint32_t size;
+        GLenum encoding;
+        Context::Texture::Storage upload;
+        uint32_t stride;
+        //one decoded row of RLE and QOI images
+        std::vector<uint8_t> row;
+        std::atomic<bool> done{ false };
+        bool failed = false;
+    };
+    BackgroundQueue uploader;
+    std::vector<TextureUpload*> uploads;
 
-                result[i] = std::clamp(sf * src[i] + df * dst[i], 0.f, 1.f);
+    //where an RLE packet left off, packets may run across rows
+    struct RLEState
+    {
+        const uint8_t* src;
+        const uint8_t* end;
+        uint8_t remaining = 0;
+        bool repeat = false;
+    };
+    bool decodeRLE(RLEState& rle, uint8_t* row, uint16_t count, uint8_t size)
+    {
+        while (count)
+        {
+            if (!rle.remaining)
+            {
+                if (rle.src == rle.end)
+                    return false;
+                const uint8_t control = *rle.src++;
+                rle.repeat = control & 0x80;
+                rle.remaining = (control & 0x7F) + 1;
             }
+            const uint16_t run = min<uint16_t>(rle.remaining, count);
+            if (rle.repeat)
             {
-                const float sf = blendFactorCalc(context->glBlendAlphaSrc, src, dst, 3);
-                const float df = blendFactorCalc(context->glBlendAlphaDst, src, dst, 3);
-
-                result[3] = std::clamp(sf * src[3] + df * dst[3], 0.f, 1.f);
+                if (rle.end - rle.src < size)
+                    return false;
+                for (uint16_t i = 0; i < run; i++, row += size)
+                    memcpy(row, rle.src, size);
+                if (rle.remaining == run)
+                    rle.src += size;
+            }
+            else
+            {
+                if (rle.end - rle.src < run * size)
+                    return false;
+                memcpy(row, rle.src, run * size);
+                row += run * size;
+                rle.src += run * size;
             }
-            for (uint8_t i = 0; i < 4; i++)
-                src[i] = result[i];
+            rle.remaining -= run;
+            count -= run;
         }
-        returnAlpha = src[3] * 255.f;
-        return RGBto565(src[0] * 255.f, src[1] * 255.f, src[2] * 255.f);
+        return true;
     }
-    void rasterizeTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2)
+#define qoiHeaderSize 14
+#define qoiEndMarkerSize 8
+    //decoder of https://qoiformat.org/qoi-specification.pdf, the pixel and index carried from row to row
+    struct QOIState
     {
-        auto edgeFunction = [](const Vector2& a, const Vector2 &b, const Vector2 &c){ return (c.x - a.x) * (b.y - a.y) - (c.y - a.y) * (b.x - a.x); };
-        bool sameColor = (v0.col[0] == v1.col[0] && v1.col[0] == v2.col[0] && v0.col[1] == v1.col[1] && v1.col[1] == v2.col[1] && v0.col[2] == v1.col[2] && v1.col[2] == v2.col[2]);
-
-        Vector2 vcoords[3] = { {v0.pos[0], v0.pos[1] }, {v1.pos[0], v1.pos[1] }, {v2.pos[0], v2.pos[1] }};
-        if (context->glCullFace)
+        const uint8_t* src;
+        //start of the end marker, which keeps the up to 4 bytes after the last op byte inside the data
+        const uint8_t* end;
+        uint8_t pixel[4] = { 0, 0, 0, 255 };
+        uint8_t index[64][4] = {};
+        uint8_t run = 0;
+    };
+    bool decodeQOI(QOIState& qoi, uint8_t* row, uint16_t count, uint8_t size)
+    {
+        for (uint16_t i = 0; i < count; i++, row += size)
         {
-            float area = edgeFunction(vcoords[0], vcoords[1], vcoords[2]);
-            if (context->glFrontFace == GL_CCW && context->glCullFaceMode == GL_BACK ||
-                context->glFrontFace == GL_CW && context->glCullFaceMode == GL_FRONT)
-            {
-                if (area > 0.f)
-                    return;
-            }
-            else if (context->glFrontFace == GL_CW && context->glCullFaceMode == GL_BACK ||
-                context->glFrontFace == GL_CCW && context->glCullFaceMode == GL_FRONT)
+            uint8_t* px = qoi.pixel;
+            if (qoi.run)
+                qoi.run--;
+            else
             {
-                if (area < 0.f)
-                    return;
+                if (qoi.src >= qoi.end)
+                    return false;
+                const uint8_t op = *qoi.src++;
+                if (op == 0xFE)
+                {
+                    memcpy(px, qoi.src, 3);
+                    qoi.src += 3;
+                }
+                else if (op == 0xFF)
+                {
+                    memcpy(px, qoi.src, 4);
+                    qoi.src += 4;
+                }
+                else switch (op >> 6)
+                {
+                case 0:
+                    memcpy(px, qoi.index[op], 4);
+                    break;
+                case 1:
+                    px[0] += (op >> 4 & 3) - 2;
+                    px[1] += (op >> 2 & 3) - 2;
+                    px[2] += (op & 3) - 2;
+                    break;
+                case 2:
+                {
+                    const int8_t dg = (op & 0x3F) - 32;
+                    const uint8_t drdb = *qoi.src++;
+                    px[0] += dg + (drdb >> 4) - 8;
+                    px[1] += dg;
+                    px[2] += dg + (drdb & 0xF) - 8;
+                    break;
+                }
+                default:
+                    qoi.run = op & 0x3F;
+                    break;
+                }
+                memcpy(qoi.index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) & 63], px, 4);
             }
+            memcpy(row, px, size);
         }
-        auto targetColor = (*context->surfaceFirstFrameBuffer ? context->pixels.first : context->pixels.second);
-        auto targetAlpha = (*context->surfaceFirstFrameBuffer ? context->alpha.first : context->alpha.second);
-
-        Vector2 amin{+FLT_MAX, +FLT_MAX};
-
-        Vector2 amax{-FLT_MAX, -FLT_MAX};
-
-        for (int8_t i = 0; i < 3; i++)
+        return true;
+    }
+    void uploadTexture(void* data)
+    {
+        TextureUpload& job = *static_cast<TextureUpload*>(data);
+        const Context::Texture& image = job.levels[0];
+        const uint8_t size = texelSize(job.upload);
+        if (job.encoding == GL_NO_ENCODING_ESP)
+            copyTexels(image, 0, 0, image.width, image.height, job.data, job.upload, job.stride);
+        else
         {
-            Vector2 p = vcoords[i];
-
-            amin.x = min(p.x, amin.x);
-            amin.y = min(p.y, amin.y);
-
-            amax.x = max(p.x, amax.x);
-            amax.y = max(p.y, amax.y);
+            RLEState rle = { job.data, job.data + job.size };
+            QOIState qoi;
+            qoi.src = job.data + qoiHeaderSize;
+            qoi.end = job.data + job.size - qoiEndMarkerSize;
+            for (uint16_t y = 0; y < image.height && !job.failed; y++)
+            {
+                job.failed = !(job.encoding == GL_RLE_ESP ? decodeRLE(rle, job.row.data(), image.width, size) :
+                    decodeQOI(qoi, job.row.data(), image.width, size));
+                if (!job.failed)
+                    copyTexels(image, 0, y, image.width, 1, job.row.data(), job.upload, 0);
+            }
         }
-
-        amin.x = std::clamp(amin.x, -1.0f, +1.0f);
-        amax.x = std::clamp(amax.x, -1.0f, +1.0f);
-
-        amin.y = std::clamp(amin.y, -1.0f, +1.0f);
-        amax.y = std::clamp(amax.y, -1.0f, +1.0f);
-
-        const float doublePixelWidth = 2.0f / static_cast<float>(context->width);
-        const float doublePixelHeight = 2.0f / static_cast<float>(context->height);
-
-        const float max0 = 1 / edgeFunction(vcoords[1], vcoords[2], vcoords[0]);
-        const float max1 = 1 / edgeFunction(vcoords[2], vcoords[0], vcoords[1]);
-        const float max2 = 1 / edgeFunction(vcoords[0], vcoords[1], vcoords[2]);
-
-        Vector2 p;
-
-        int32_t minX = static_cast<int32_t>(floor((0.5f + 0.5f * amin.x) * context->width));
-        int32_t maxX = static_cast<int32_t>(ceil((0.5f + 0.5f * amax.x) * context->width));
-        int32_t minY = static_cast<int32_t>(floor((0.5f + 0.5f * amin.y) * context->height));
-        int32_t maxY = static_cast<int32_t>(ceil((0.5f + 0.5f * amax.y) * context->height));
-
-        for (int32_t iy = minY; iy < maxY; iy++)
+        for (size_t i = 1; i < job.levels.size(); i++)
+            downsampleLevel(job.levels[i - 1], job.levels[i]);
+        job.done.store(true, std::memory_order_release);
+    }
+    void collectUploads()
+    {
+        for (size_t i = 0; i < uploads.size();)
         {
-            p.y = -1.0f + static_cast<float>(iy) * doublePixelHeight;
-            bool optimizationEnteredTriangle = false;
-            for (int32_t ix = minX; ix < maxX; ix++)
+            TextureUpload* job = uploads[i];
+            if (!job->done.load(std::memory_order_acquire))
             {
-                p.x = -1.0f + static_cast<float>(ix) * doublePixelWidth;
-                float w0 = edgeFunction(vcoords[1], vcoords[2], p);
-                float w1 = edgeFunction(vcoords[2], vcoords[0], p);
-                float w2 = edgeFunction(vcoords[0], vcoords[1], p);
-
-                // clipping emulation
-                // float clipping[4] = {
-                //     v0.pos[0] * w0 + v1.pos[0] * w1 + v2.pos[0] * w2,
-                //     v0.pos[1] * w0 + v1.pos[1] * w1 + v2.pos[1] * w2,
-                //     v0.pos[2] * w0 + v1.pos[2] * w1 + v2.pos[2] * w2,
-                //     v0.pos[3] * w0 + v1.pos[3] * w1 + v2.pos[3] * w2
-                // };
-                // if (clipping[0] > clipping[3] || clipping[0] < -clipping[3] ||
-                //     clipping[1] > clipping[3] || clipping[1] < -clipping[3] ||
-                //     clipping[2] > clipping[3] || clipping[2] < -clipping[3])
-                //     continue;
-
-                if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f || w0 <= 0.0f && w1 <= 0.0f && w2 <= 0.0f)
-                {
-                    optimizationEnteredTriangle = true;
-                    uint32_t iBuf = (context->height - static_cast<int32_t>(iy) - 1) * context->width + ix;
-                    float weight0 = w0 * max0;
-                    float weight1 = w1 * max1;
-                    float weight2 = w2 * max2;
-                    uint16_t dstColor = 0;
-                    uint8_t dstAlpha = 255;
-                    uint8_t returnAlpha = 255;
-                    bool discard = false;
-
-                    if (context->glBlend)
-                    {
-                        dstColor = swapBytes(targetColor[iBuf]);
-                        if (targetAlpha)
-                            dstAlpha = targetAlpha[iBuf];
-                    }
-
-                    uint16_t color = fragmentShader(v0, v1, v2, weight0, weight1, weight2, sameColor, dstColor, dstAlpha, discard, returnAlpha);
-
-                    if (discard)
-                        continue;
-
-                    targetColor[iBuf] = swapBytes(color);
-                    if (targetAlpha)
-                        targetAlpha[iBuf] = returnAlpha;
-                }
-                else if (optimizationEnteredTriangle)
-                    break;
+                i++;
+                continue;
             }
+            if (job->failed)
+                ESP_LOGE(LIBRARY_NAME, "glTexImage2DAsyncESP data ends before the image");
+            //a later upload into the same texture keeps it unsampled
+            job->texture->uploading = false;
+            for (const TextureUpload* other : uploads)
+                if (other != job && other->texture == job->texture && !other->done.load(std::memory_order_acquire))
+                    job->texture->uploading = true;
+            delete job;
+            uploads.erase(uploads.begin() + i);
+        }
+    }
+    //blocks until no upload writes tex any more, before anything else reads or changes its levels
+    void finishUploads(const Context::Texture& tex)
+    {
+        if (!tex.uploading)
+            return;
+        uploader.wait();
+        collectUploads();
+    }
+    void glTexCropRect(GLenum target, const GLint rect[4])
+    {
+        if (target != GL_TEXTURE_2D)
+        {
+            lastError = GL_INVALID_ENUM;
+            return;
         }
+        memcpy(context->glTextures[context->glTextureUnit[context->glActiveTexture].glBoundTexture].cropRect, rect, 4 * sizeof(GLint));
     }
     uint8_t glGet(GLenum pname, GLfloat* data)
     {
@@ -394,7 +2863,7 @@ namespace
         case 0x821C: data[0] = 1; return 1;
         case GL_FRAMEBUFFER_BINDING_OES: if (data) data[0] = 0; return 1;
         case GL_ACTIVE_TEXTURE: if (data) data[0] = context->glActiveTexture; return 1;
-        // case GL_ALIASED_POINT_SIZE_RANGE: break;
+        case GL_ALIASED_POINT_SIZE_RANGE: if (data) { data[0] = 1; data[1] = glGetMaxPointSize; } return 2;
         // case GL_ALIASED_LINE_WIDTH_RANGE: break;
         case GL_ALPHA_BITS: if (data) data[0] = context->config->alpha; return 1;
         case GL_ALPHA_TEST: if (data) data[0] = context->glAlphaTest; return 1;
@@ -429,7 +2898,14 @@ namespace
         // case GL_COLOR_LOGIC_OP: break;
         // case GL_COLOR_MATERIAL: break;
         // case GL_COLOR_WRITEMASK: break;
-        // case GL_COMPRESSED_TEXTURE_FORMATS: break;
+        case GL_COMPRESSED_TEXTURE_FORMATS:
+            if (data)
+            {
+                for (uint8_t i = 0; i <= GL_PALETTE8_RGB5_A1_OES - GL_PALETTE4_RGB8_OES; i++)
+                    data[i] = GL_PALETTE4_RGB8_OES + i;
+                data[GL_PALETTE8_RGB5_A1_OES - GL_PALETTE4_RGB8_OES + 1] = GL_ETC1_RGB8_OES;
+            }
+            return GL_PALETTE8_RGB5_A1_OES - GL_PALETTE4_RGB8_OES + 2;
         case GL_CULL_FACE: if (data) data[0] = context->glCullFace; return 1;
         case GL_CULL_FACE_MODE: if (data) data[0] = context->glCullFaceMode; return 1;
         // case GL_CURRENT_COLOR: break;
@@ -437,10 +2913,10 @@ namespace
         // case GL_CURRENT_TEXTURE_COORDS: break;
         case GL_DEPTH_BITS: if (data) data[0] = context->config->depth; return 1;
         case GL_DEPTH_CLEAR_VALUE: if (data) data[0] = context->glClearDepth; return 1;
-        // case GL_DEPTH_FUNC: break;
-        // case GL_DEPTH_RANGE: break;
-        // case GL_DEPTH_TEST: break;
-        // case GL_DEPTH_WRITEMASK: break;
+        case GL_DEPTH_FUNC: if (data) data[0] = context->glDepthFunc; return 1;
+        case GL_DEPTH_RANGE: if (data) { data[0] = context->glDepthRangeNear; data[1] = context->glDepthRangeFar; } return 2;
+        case GL_DEPTH_TEST: if (data) data[0] = context->glDepthTest; return 1;
+        case GL_DEPTH_WRITEMASK: if (data) data[0] = context->glDepthMask; return 1;
         // case GL_ELEMENT_ARRAY_BUFFER_BINDING: break;
         // case GL_FOG: break;
         // case GL_FOG_COLOR: break;
@@ -487,16 +2963,27 @@ namespace
         case GL_NORMAL_ARRAY_STRIDE: if (data) data[0] = context->glNormalPointerStride; return 1;
         case GL_NORMAL_ARRAY_TYPE: if (data) data[0] = context->glNormalPointerType; return 1;
         // case GL_NORMALIZE: break;
-        // case GL_NUM_COMPRESSED_TEXTURE_FORMATS: break;
-        // case GL_PACK_ALIGNMENT: break;
+        case GL_NUM_COMPRESSED_TEXTURE_FORMATS: if (data) data[0] = GL_PALETTE8_RGB5_A1_OES - GL_PALETTE4_RGB8_OES + 2; return 1;
+        case GL_PACK_ALIGNMENT: if (data) data[0] = context->glPackAlignment; return 1;
         // case GL_PERSPECTIVE_CORRECTION_HINT: break;
-        // case GL_POINT_DISTANCE_ATTENUATION: break;
-        // case GL_POINT_FADE_THRESHOLD_SIZE: break;
-        // case GL_POINT_SIZE: break;
-        // case GL_POINT_SIZE_MAX: break;
-        // case GL_POINT_SIZE_MIN: break;
+        case GL_POINT_DISTANCE_ATTENUATION:
+            if (data)
+            {
+                data[0] = context->glPointDistanceAttenuation[0];
+                data[1] = context->glPointDistanceAttenuation[1];
+                data[2] = context->glPointDistanceAttenuation[2];
+            }
+            return 3;
+        case GL_POINT_FADE_THRESHOLD_SIZE: if (data) data[0] = context->glPointFadeThreshold; return 1;
+        case GL_POINT_SIZE: if (data) data[0] = context->glPointSize; return 1;
+        case GL_POINT_SIZE_ARRAY_OES: if (data) data[0] = context->glUsePointSizeArray; return 1;
+        case GL_POINT_SIZE_ARRAY_STRIDE_OES: if (data) data[0] = context->glPointSizePointerStride; return 1;
+        case GL_POINT_SIZE_ARRAY_TYPE_OES: if (data) data[0] = context->glPointSizePointerType; return 1;
+        case GL_POINT_SIZE_MAX: if (data) data[0] = context->glPointSizeMax; return 1;
+        case GL_POINT_SIZE_MIN: if (data) data[0] = context->glPointSizeMin; return 1;
         // case GL_POINT_SMOOTH: break;
         // case GL_POINT_SMOOTH_HINT: break;
+        case GL_POINT_SPRITE_OES: if (data) data[0] = context->glPointSprite; return 1;
         // case GL_POLYGON_OFFSET_FACTOR: break;
         // case GL_POLYGON_OFFSET_FILL: break;
         // case GL_POLYGON_OFFSET_UNITS: break;
@@ -514,21 +3001,29 @@ namespace
         // case GL_SAMPLE_COVERAGE_INVERT: break;
         // case GL_SAMPLE_COVERAGE_VALUE: break;
         // case GL_SAMPLES: break;
-        // case GL_SCISSOR_BOX: break;
-        // case GL_SCISSOR_TEST: break;
+        case GL_SCISSOR_BOX:
+            if (data)
+            {
+                data[0] = context->glScissorX;
+                data[1] = context->glScissorY;
+                data[2] = context->glScissorWidth;
+                data[3] = context->glScissorHeight;
+            }
+            return 4;
+        case GL_SCISSOR_TEST: if (data) data[0] = context->glScissorTest; return 1;
         // case GL_SHADE_MODEL: break;
         // case GL_SMOOTH_LINE_WIDTH_RANGE: break;
-        // case GL_SMOOTH_POINT_SIZE_RANGE: break;
+        case GL_SMOOTH_POINT_SIZE_RANGE: if (data) { data[0] = 1; data[1] = glGetMaxPointSize; } return 2;
         case GL_STENCIL_BITS: if (data) data[0] = context->config->stencil; return 1;
-        // case GL_STENCIL_CLEAR_VALUE: break;
-        // case GL_STENCIL_FAIL: break;
-        // case GL_STENCIL_FUNC: break;
-        // case GL_STENCIL_PASS_DEPTH_FAIL: break;
-        // case GL_STENCIL_PASS_DEPTH_PASS: break;
-        // case GL_STENCIL_REF: break;
-        // case GL_STENCIL_TEST: break;
-        // case GL_STENCIL_VALUE_MASK: break;
-        // case GL_STENCIL_WRITEMASK: break;
+        case GL_STENCIL_CLEAR_VALUE: if (data) data[0] = context->glClearStencil; return 1;
+        case GL_STENCIL_FAIL: if (data) data[0] = context->glStencilFail; return 1;
+        case GL_STENCIL_FUNC: if (data) data[0] = context->glStencilFunc; return 1;
+        case GL_STENCIL_PASS_DEPTH_FAIL: if (data) data[0] = context->glStencilPassDepthFail; return 1;
+        case GL_STENCIL_PASS_DEPTH_PASS: if (data) data[0] = context->glStencilPassDepthPass; return 1;
+        case GL_STENCIL_REF: if (data) data[0] = context->glStencilRef; return 1;
+        case GL_STENCIL_TEST: if (data) data[0] = context->glStencilTest; return 1;
+        case GL_STENCIL_VALUE_MASK: if (data) data[0] = context->glStencilValueMask; return 1;
+        case GL_STENCIL_WRITEMASK: if (data) data[0] = context->glStencilWriteMask; return 1;
         // case GL_SUBPIXEL_BITS: break;
         case GL_TEXTURE_2D: if (data) data[0] = context->glTextureUnit[context->glActiveTexture].glEnabled; return 1;
         case GL_TEXTURE_BINDING_2D: if (data) data[0] = context->glTextureUnit[context->glActiveTexture].glBoundTexture; return 1;
@@ -543,7 +3038,21 @@ namespace
                     data[i] = context->glTextureUnit[context->glActiveTexture].glTextureMatrix.back()[i];
             return 16;
         case GL_TEXTURE_STACK_DEPTH: if (data) data[0] = context->glTextureUnit[context->glActiveTexture].glTextureMatrix.size(); return 1;
-        // case GL_UNPACK_ALIGNMENT: break;
+        case GL_TILE_BINNING_ESP: if (data) data[0] = context->glTileBinning; return 1;
+        case GL_RASTER_WORKERS_ESP: if (data) data[0] = scheduler.workerCount(); return 1;
+        case GL_TEXEL_CACHE_ESP: if (data) data[0] = context->glTexelCache; return 1;
+        case GL_TEXEL_CACHE_HITS_ESP:
+        case GL_TEXEL_CACHE_MISSES_ESP:
+            //triangles still binned are not counted, querying must not flush them
+            if (data)
+            {
+                uint32_t count = 0;
+                for (const TexelCache& cache : texelCaches)
+                    count += pname == GL_TEXEL_CACHE_HITS_ESP ? cache.hits : cache.misses;
+                data[0] = count;
+            }
+            return 1;
+        case GL_UNPACK_ALIGNMENT: if (data) data[0] = context->glUnpackAlignment; return 1;
         case GL_VIEWPORT:
             if (data)
             {
@@ -555,12 +3064,12 @@ namespace
             return 4;
         case GL_VERTEX_ARRAY: if (data) data[0] = context->glUseVertexArray; return 1;
         // case GL_VERTEX_ARRAY_BUFFER_BINDING: break;
-        case GL_VERTEX_ARRAY_SIZE: if (data) data[0] = context->glVertexPointerSize; break;
-        case GL_VERTEX_ARRAY_STRIDE: if (data) data[0] = context->glVertexPointerStride; break;
-        case GL_VERTEX_ARRAY_TYPE: if (data) data[0] = context->glVertexPointerType; break;
+        case GL_VERTEX_ARRAY_SIZE: if (data) data[0] = context->glVertexPointerSize; return 1;
+        case GL_VERTEX_ARRAY_STRIDE: if (data) data[0] = context->glVertexPointerStride; return 1;
+        case GL_VERTEX_ARRAY_TYPE: if (data) data[0] = context->glVertexPointerType; return 1;
         default:
             ESP_LOGE(LIBRARY_NAME, "glGet Enum not implemented: %d", pname);
-            break;
+            return 0;
         }
     }
     void glSet(GLenum cap, bool value)
@@ -572,7 +3081,7 @@ namespace
         // case GL_COLOR_LOGIC_OP: break;
         // case GL_COLOR_MATERIAL: break;
         case GL_CULL_FACE: context->glCullFace = value; break;
-        // case GL_DEPTH_TEST: break;
+        case GL_DEPTH_TEST: context->glDepthTest = value; break;
         // case GL_DITHER: break;
         // case GL_FOG: break;
         // case GL_LIGHTING: break;
@@ -580,19 +3089,77 @@ namespace
         // case GL_MULTISAMPLE: break;
         // case GL_NORMALIZE: break;
         // case GL_POINT_SMOOTH: break;
+        case GL_POINT_SPRITE_OES: context->glPointSprite = value; break;
         // case GL_POLYGON_OFFSET_FILL: break;
         // case GL_RESCALE_NORMAL: break;
         // case GL_SAMPLE_ALPHA_TO_COVERAGE: break;
         // case GL_SAMPLE_ALPHA_TO_ONE: break;
         // case GL_SAMPLE_COVERAGE: break;
-        // case GL_SCISSOR_TEST: break;
-        // case GL_STENCIL_TEST: break;
+        case GL_SCISSOR_TEST: context->glScissorTest = value; break;
+        case GL_STENCIL_TEST: context->glStencilTest = value; break;
         case GL_TEXTURE_2D: context->glTextureUnit[context->glActiveTexture].glEnabled = value; break;
+        case GL_TILE_BINNING_ESP:
+            if (!value)
+                resolveBins();
+            context->glTileBinning = value;
+            break;
+        case GL_TEXEL_CACHE_ESP:
+            resolveBins();
+            if (value)
+            {
+                initTexelCaches(scheduler.workerCount());
+                for (TexelCache& cache : texelCaches)
+                    cache.hits = cache.misses = 0;
+            }
+            context->glTexelCache = value;
+            break;
         default:
             ESP_LOGE(LIBRARY_NAME, "glSet Enum not implemented: %d", cap);
             break;
         }
     }
+    void glTexEnv(GLenum target, GLenum pname, GLint param)
+    {
+        if (target == GL_POINT_SPRITE_OES && pname == GL_COORD_REPLACE_OES)
+        {
+            context->glTextureUnit[context->glActiveTexture].glCoordReplace = param;
+            return;
+        }
+        if (target != GL_TEXTURE_ENV && target != GL_POINT_SPRITE_OES)
+        {
+            lastError = GL_INVALID_ENUM;
+            return;
+        }
+        ESP_LOGE(LIBRARY_NAME, "glTexEnv Enum not implemented: %d", pname);
+    }
+    void glPointParameter(GLenum pname, const GLfloat* params, uint8_t count)
+    {
+        switch (pname)
+        {
+        case GL_POINT_SIZE_MIN:
+        case GL_POINT_SIZE_MAX:
+        case GL_POINT_FADE_THRESHOLD_SIZE:
+            if (params[0] < 0.f)
+            {
+                lastError = GL_INVALID_VALUE;
+                return;
+            }
+            if (pname == GL_POINT_SIZE_MIN)
+                context->glPointSizeMin = params[0];
+            else if (pname == GL_POINT_SIZE_MAX)
+                context->glPointSizeMax = params[0];
+            else
+                context->glPointFadeThreshold = params[0];
+            return;
+        case GL_POINT_DISTANCE_ATTENUATION:
+            if (count < 3)
+                break;
+            for (uint8_t i = 0; i < 3; i++)
+                context->glPointDistanceAttenuation[i] = params[i];
+            return;
+        }
+        lastError = GL_INVALID_ENUM;
+    }
     void glTexParameter(GLenum target, GLenum pname, GLint param)
     {
         if (target != GL_TEXTURE_2D)
@@ -611,7 +3178,7 @@ namespace
             case GL_LINEAR_MIPMAP_NEAREST:
             case GL_NEAREST_MIPMAP_LINEAR:
             case GL_LINEAR_MIPMAP_LINEAR:
-                context->glTextureUnit[context->glActiveTexture].glTextureMagFilter = param;
+                context->glTextureUnit[context->glActiveTexture].glTextureMinFilter = param;
                 return;
             default:
                 lastError = GL_INVALID_ENUM;
@@ -651,8 +3218,30 @@ namespace
                 return;
             }
             case GL_GENERATE_MIPMAP:
-            ESP_LOGE(LIBRARY_NAME, "glTexParameterf not implemented");
-            break;
+            context->glTextures[context->glTextureUnit[context->glActiveTexture].glBoundTexture].generateMipmap = param != 0;
+            return;
+        case GL_TEXTURE_STORAGE_TYPE_ESP:
+            switch (param)
+            {
+            case GL_UNSIGNED_BYTE:
+            case GL_UNSIGNED_SHORT_5_6_5:
+            case GL_UNSIGNED_SHORT_4_4_4_4:
+            case GL_UNSIGNED_SHORT_5_5_5_1:
+                context->glTextures[context->glTextureUnit[context->glActiveTexture].glBoundTexture].storageType = param;
+                return;
+            default:
+                lastError = GL_INVALID_ENUM;
+                return;
+            }
+        case GL_TEXTURE_TILED_ESP:
+        {
+            Context::Texture& tex = context->glTextures[context->glTextureUnit[context->glActiveTexture].glBoundTexture];
+            resolveBins();
+            finishUploads(tex);
+            if (!setTextureTiled(tex, param != 0))
+                lastError = GL_OUT_OF_MEMORY;
+            return;
+        }
         default:
             lastError = GL_INVALID_ENUM;
             return;
@@ -776,6 +3365,30 @@ void glClear(GLbitfield mask)
         lastError = GL_INVALID_VALUE;
         return;
     }
+    int16_t minX, minY, maxX, maxY;
+    scissorRect(minX, minY, maxX, maxY);
+    if (minX > maxX || minY > maxY)
+        return;
+    const bool full = minX == 0 && minY == 0 && maxX == context->width - 1 && maxY == context->height - 1;
+    const int16_t width = maxX - minX + 1;
+    if (mask & GL_COLOR_BUFFER_BIT)
+    {
+        uint16_t val = swapBytes(RGBto565(context->glClearColorRed * 255.f,
+            context->glClearColorGreen * 255.f,
+            context->glClearColorBlue * 255.f));
+        if (context->glTileBinning)
+        {
+            resolveBins();
+            if (full)
+            {
+                //tiles start from the clear color instead of being loaded from the frame buffer
+                binner.pendingClear = true;
+                binner.clearColor = val;
+                binner.clearAlpha = context->glClearColorAlpha * 255.f;
+                mask &= ~GL_COLOR_BUFFER_BIT;
+            }
+        }
+    }
     if (mask & GL_COLOR_BUFFER_BIT)
     {
         uint16_t val = swapBytes(RGBto565(context->glClearColorRed * 255.f,
@@ -783,25 +3396,83 @@ void glClear(GLbitfield mask)
             context->glClearColorBlue * 255.f));
         auto& color = *context->surfaceFirstFrameBuffer ? context->pixels.first : context->pixels.second;
         auto& alpha = *context->surfaceFirstFrameBuffer ? context->alpha.first : context->alpha.second;
-        for (uint32_t i = 0; i < context->width * context->height; i++)
+        for (int32_t y = minY; y <= maxY; y++)
         {
-            color[i] = val;
+            std::fill_n(color + y * context->width + minX, width, val);
             if (alpha)
-                alpha[i] = context->glClearColorAlpha * 255.f;
+                std::fill_n(alpha + y * context->width + minX, width, static_cast<uint8_t>(context->glClearColorAlpha * 255.f));
         }
     }
     if (mask & GL_DEPTH_BUFFER_BIT)
     {
         uint16_t val = context->glClearDepth * 65535;
-            auto& buff = *context->surfaceFirstFrameBuffer ? context->depth.first : context->depth.second;
-            for (uint32_t i = 0; i < context->width * context->height; i++)
-                buff[i] = val;
+        auto& buff = *context->surfaceFirstFrameBuffer ? context->depth.first : context->depth.second;
+        if (buff)
+        {
+            //binned triangles have to test the old depth, a full clear after the color one finds none and stays deferred
+            if (context->glTileBinning && (!full || !binner.triangles.empty()))
+                resolveBins();
+            if (context->glTileBinning && full)
+            {
+                //like the color clear, tiles start from the clear value
+                binner.pendingDepthClear = true;
+                binner.clearDepth = val;
+            }
+            else
+            {
+                for (int32_t y = minY; y <= maxY; y++)
+                    std::fill_n(buff + y * context->width + minX, width, val);
+            }
+            uint16_t* bounds = currentDepthMax();
+            if (full)
+                std::fill_n(bounds, depthMaxSize(), val);
+            else
+            {
+                //blocks only partly cleared keep whatever was farther
+                for (int32_t by = minY / rasterBlockSize; by <= maxY / rasterBlockSize; by++)
+                    for (int32_t bx = minX / rasterBlockSize; bx <= maxX / rasterBlockSize; bx++)
+                        bounds[by * depthMaxStride() + bx] = max(bounds[by * depthMaxStride() + bx], val);
+            }
+        }
     }
     if (mask & GL_STENCIL_BUFFER_BIT)
     {
         auto& buff = *context->surfaceFirstFrameBuffer ? context->stencil.first : context->stencil.second;
-        for (uint32_t i = 0; i < context->width * context->height; i++)
-            buff[i] = context->glClearStencil;
+        if (buff)
+        {
+            //binned draws testing stencil have to see the old values
+            if (binner.usesStencil)
+                resolveBins();
+            const uint8_t writeMask = context->glStencilWriteMask;
+            const uint8_t val = context->glClearStencil & writeMask;
+            for (int32_t y = minY; y <= maxY; y++)
+                for (int32_t x = minX; x <= maxX; x++)
+                    buff[y * context->width + x] = (buff[y * context->width + x] & ~writeMask) | val;
+
+            Context::StencilMask& stencil = currentStencilMask();
+            if (full && writeMask == 0xFF)
+            {
+                stencil = Context::StencilMask();
+                stencil.known = true;
+                stencil.outside = val;
+            }
+            else if (full)
+            {
+                stencil.inside = (stencil.inside & ~writeMask) | val;
+                stencil.outside = (stencil.outside & ~writeMask) | val;
+            }
+            else if (stencil.known && stencil.minX > stencil.maxX)
+            {
+                //a scissored clear of a uniform buffer is a rectangular mask as well
+                stencil.inside = (stencil.outside & ~writeMask) | val;
+                stencil.minX = minX;
+                stencil.minY = minY;
+                stencil.maxX = stencil.inside == stencil.outside ? -1 : maxX;
+                stencil.maxY = maxY;
+            }
+            else
+                stencil.known = false;
+        }
     }
 }
 
@@ -894,18 +3565,99 @@ void glColorPointer(GLint size, GLenum type, GLsizei stride, const void* pointer
 void glCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height,
     GLint border, GLsizei imageSize, const void* data)
 {
-    ESP_LOGE(LIBRARY_NAME, "glCompressedTexImage2D unimplemented");
+    if (target != GL_TEXTURE_2D)
+    {
+        lastError = GL_INVALID_ENUM;
+        return;
+    }
+    Context::Texture::Storage storage, entry;
+    uint16_t entries;
+    if (!compressedTextureStorage(internalformat, storage, entry, entries))
+        return;
+    //paletted images carry 1 - level levels after one shared palette
+    const GLint levels = entries ? 1 - level : 1;
+    if (width < 0 || height < 0 || width > glGetMaxTextureSize || height > glGetMaxTextureSize || border != 0 ||
+        (entries ? level > 0 || levels > 16 || max(max(width, height), 1) >> (levels - 1) == 0 : level < 0 || level > glGetMaxTextureLevel))
+    {
+        lastError = GL_INVALID_VALUE;
+        return;
+    }
+    const uint32_t paletteSize = entries * texelSize(entry);
+    uint32_t size = paletteSize;
+    for (GLint i = 0; i < levels; i++)
+        size += levelSize(max(width >> i, 1), max(height >> i, 1), storage, false);
+    if (imageSize < 0 || static_cast<uint32_t>(imageSize) != size)
+    {
+        lastError = GL_INVALID_VALUE;
+        return;
+    }
+
+    resolveBins();
+    Context::Texture& tex = context->glTextures[context->glTextureUnit[context->glActiveTexture].glBoundTexture];
+    finishUploads(tex);
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (entries)
+    {
+        //the palette and every level are redefined together
+        freeTexture(tex);
+        tex.palette = static_cast<uint32_t*>(heap_caps_malloc(entries * sizeof(uint32_t), MALLOC_CAP_8BIT));
+        if (!tex.palette)
+        {
+            lastError = GL_OUT_OF_MEMORY;
+            return;
+        }
+        if (data)
+            for (uint16_t i = 0; i < entries; i++)
+                tex.palette[i] = texelRGBA(entry, bytes, i);
+        bytes += paletteSize;
+        tex.mipmaps.resize(levels - 1);
+        level = 0;
+    }
+    else if (level > static_cast<GLint>(tex.mipmaps.size()))
+        tex.mipmaps.resize(level);
+    for (GLint i = level; i < level + levels; i++)
+    {
+        Context::Texture& image = i == 0 ? tex : tex.mipmaps[i - 1];
+        const uint16_t levelWidth = max(width >> (i - level), 1), levelHeight = max(height >> (i - level), 1);
+        allocateLevel(image, levelWidth, levelHeight, internalformat, storage, tex.tiled);
+        if (i == 0 && !entries)
+            freePalette(tex);
+        image.palette = tex.palette;
+        if (!image.data)
+        {
+            //a paletted texture missing some of its levels is dropped whole rather than sampled half defined
+            if (entries)
+                freeTexture(tex);
+            lastError = GL_OUT_OF_MEMORY;
+            return;
+        }
+        if (data)
+            memcpy(image.data, bytes, levelSize(levelWidth, levelHeight, storage, false));
+        bytes += levelSize(levelWidth, levelHeight, storage, false);
+    }
 }
 
 void glCompressedTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
     GLsizei height, GLenum format, GLsizei imageSize, const void* data)
 {
-    ESP_LOGE(LIBRARY_NAME, "glCompressedTexSubImage2D unimplemented");
+    //neither OES_compressed_paletted_texture nor OES_compressed_ETC1_RGB8_texture allow updating parts of an image
+    lastError = target != GL_TEXTURE_2D ? GL_INVALID_ENUM : GL_INVALID_OPERATION;
 }
 
 void glCopyTexImage2D(GLenum target, GLint level, GLenum internalformat, GLint x, GLint y, GLsizei width,
     GLsizei height, GLint border)
 {
+    if (target != GL_TEXTURE_2D)
+    {
+        lastError = GL_INVALID_ENUM;
+        return;
+    }
+    if (level < 0 || level > glGetMaxTextureLevel || border != 0 || width < 0 || height < 0 ||
+        width > glGetMaxTextureSize || height > glGetMaxTextureSize)
+    {
+        lastError = GL_INVALID_VALUE;
+        return;
+    }
     ESP_LOGE(LIBRARY_NAME, "glCopyTexImage2D unimplemented");
 }
 
@@ -922,7 +3674,7 @@ void glCullFace(GLenum mode)
     case GL_FRONT:
     case GL_BACK:
     case GL_FRONT_AND_BACK:
-        context->glCullFace = mode;
+        context->glCullFaceMode = mode;
         return;
     default:
         lastError = GL_INVALID_ENUM;
@@ -960,10 +3712,11 @@ void glDeleteTextures(GLsizei n, const GLuint* textures)
     if (textures == nullptr)
         return;
 
+    resolveBins();
     for (uint16_t i = 0; i < n; i++)
     {
-        if (context->glTextures[textures[i]].data)
-            heap_caps_free(context->glTextures[textures[i]].data);
+        finishUploads(context->glTextures[textures[i]]);
+        freeTexture(context->glTextures[textures[i]]);
         context->glTextures.erase(textures[i]);
         for (int8_t j = 0; j < 2; j++)
             if (context->glTextureUnit[j].glBoundTexture == textures[i])
@@ -973,22 +3726,38 @@ void glDeleteTextures(GLsizei n, const GLuint* textures)
 
 void glDepthFunc(GLenum func)
 {
-    ESP_LOGE(LIBRARY_NAME, "glDepthFunc unimplemented");
+    switch (func)
+    {
+    case GL_NEVER:
+    case GL_LESS:
+    case GL_LEQUAL:
+    case GL_EQUAL:
+    case GL_GREATER:
+    case GL_NOTEQUAL:
+    case GL_GEQUAL:
+    case GL_ALWAYS:
+        context->glDepthFunc = func;
+        return;
+    default:
+        lastError = GL_INVALID_ENUM;
+        return;
+    }
 }
 
 void glDepthMask(GLboolean flag)
 {
-    ESP_LOGE(LIBRARY_NAME, "glDepthMask unimplemented");
+    context->glDepthMask = flag;
 }
 
 void glDepthRangef(GLfloat n, GLfloat f)
 {
-    ESP_LOGE(LIBRARY_NAME, "glDepthRangef unimplemented");
+    context->glDepthRangeNear = std::clamp(n, 0.f, 1.f);
+    context->glDepthRangeFar = std::clamp(f, 0.f, 1.f);
 }
 
 void glDepthRangex(GLfixed n, GLfixed f)
 {
-    glDepthRangef(n, f * oneDiv65536);
+    glDepthRangef(n * oneDiv65536, f * oneDiv65536);
 }
 
 void glDisable(GLenum cap)
@@ -1002,6 +3771,7 @@ void glDisableClientState(GLenum array)
     {
     case GL_COLOR_ARRAY: context->glUseColorArray = false; return;
     case GL_NORMAL_ARRAY: context->glUseNormalArray = false; return;
+    case GL_POINT_SIZE_ARRAY_OES: context->glUsePointSizeArray = false; return;
     case GL_TEXTURE_COORD_ARRAY: context->glTextureUnit[context->glClientActiveTexture].glUseTexCoordArray = false; return;
     case GL_VERTEX_ARRAY: context->glUseVertexArray = false; return;
     default: lastError = GL_INVALID_ENUM; return;
@@ -1040,10 +3810,25 @@ void glDrawArrays(GLenum mode, GLint first, GLsizei count)
         context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointerStride :
         context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointerSize * sizeOfType(context->glTextureUnit[context->glClientActiveTexture].glTexCoordPointerType);
     uint32_t texCoordTotalOffset = first * texCoordOffset;
+    uint32_t pointSizeOffset = context->glPointSizePointerStride ? context->glPointSizePointerStride : sizeOfType(context->glPointSizePointerType);
+    uint32_t pointSizeTotalOffset = first * pointSizeOffset;
     std::array<GLfloat, 16> mvpMatrix;
     multiplyMatrixMatrix(context->glProjectionMatrix.back(), context->glModelViewMatrix.back(), mvpMatrix);
+    const bool pointSprite = mode == GL_POINTS && context->glPointSprite && context->glTextureUnit[context->glActiveTexture].glCoordReplace;
+    const DrawState state = captureDrawState(pointSprite ? SourcePointSprite : SourceArrays);
+    const RenderTarget target = frameRenderTarget();
+    if (context->glTileBinning)
+    {
+        //lines are still written straight into the frame buffer
+        if (mode == GL_LINES || mode == GL_LINE_STRIP || mode == GL_LINE_LOOP)
+            resolveBins();
+        else
+            pushBinnedState(state);
+    }
+    stencilDraw = StencilDraw();
 
     Vertex ver[3];
+    RectPairing pairing;
     uint8_t index = 0;
     uint32_t counter = 0;
     bool stripFanOrder = true;
@@ -1051,27 +3836,40 @@ void glDrawArrays(GLenum mode, GLint first, GLsizei count)
     {
         ver[index] = Vertex();
         getVertexAtOffset(vertexTotalOffset, colorTotalOffset, texCoordTotalOffset, &ver[index]);
+        const float size = mode == GL_POINTS ? pointSize(ver[index], pointSizeTotalOffset) : 0.f;
 
         vertexShader(ver[index], mvpMatrix);
         //Now render
         switch (mode)
         {
         case GL_POINTS:
-            if (ver[index].pos[0] >= -1.f && ver[index].pos[1] >= -1.f &&
-                ver[index].pos[0] < 1.f && ver[index].pos[1] < 1.f)
-            {
-                const int16_t posX = (ver[index].pos[0] + 1.f) * (context->width / 2);
-                const int16_t posY = (-ver[index].pos[1] + 1.f) * (context->height / 2);
-                const int16_t color = swapBytes(RGBto565(ver[index].col[0] * 255, ver[index].col[1] * 255, ver[index].col[2] * 255));
-                if (*context->surfaceFirstFrameBuffer)
-                    context->pixels.first[posX + posY * context->width] = color;
-                else
-                    context->pixels.second[posX + posY * context->width] = color;
+            //a point is clipped by its centre, the square then goes through the rectangle filler
+            if (ver[index].pos[3] <= 0.f || viewVolumeOutcode(ver[index]))
+                break;
+            perspectiveDivide(ver[index]);
+            {
+                TriangleSetup setup;
+                if (setupPoint(ver[index], size, pointSprite, setup))
+                    drawSetup(setup, state, target);
             }
             break;
+        case GL_LINES:
+            if (index == 1)
+                drawLine(ver[0], ver[1], state, target);
+            index ^= 1;
+            break;
+        case GL_LINE_STRIP:
+        case GL_LINE_LOOP:
+            //ver[2] keeps the first vertex to close the loop with
+            if (counter == 0)
+                ver[2] = ver[0];
+            else
+                drawLine(ver[index ^ 1], ver[index], state, target);
+            index ^= 1;
+            break;
         case GL_TRIANGLES:
             if (index % 3 == 2)
-                rasterizeTriangle(ver[0], ver[1], ver[2]);
+                submitTriangle(pairing, ver[0], ver[1], ver[2], state, target);
             index++;
             index %= 3;
             break;
@@ -1079,9 +3877,9 @@ void glDrawArrays(GLenum mode, GLint first, GLsizei count)
             if (counter >= 2)
             {
                 if (!stripFanOrder)
-                    rasterizeTriangle(ver[0], ver[1], ver[2]);
+                    submitTriangle(pairing, ver[0], ver[1], ver[2], state, target);
                 else
-                    rasterizeTriangle(ver[0], ver[2], ver[1]);
+                    submitTriangle(pairing, ver[0], ver[2], ver[1], state, target);
             }
             if (index == 2)
             {
@@ -1098,7 +3896,7 @@ void glDrawArrays(GLenum mode, GLint first, GLsizei count)
             break;
         case GL_TRIANGLE_STRIP:
             if (counter >= 2)
-                rasterizeTriangle(ver[(index + 1) % 3], ver[(index + 2) % 3], ver[(index) % 3]);
+                submitTriangle(pairing, ver[(index + 1) % 3], ver[(index + 2) % 3], ver[(index) % 3], state, target);
             index++;
             index %= 3;
             break;
@@ -1110,7 +3908,12 @@ void glDrawArrays(GLenum mode, GLint first, GLsizei count)
         vertexTotalOffset += vertexOffset;
         colorTotalOffset += colorOffset;
         texCoordTotalOffset += texCoordOffset;
+        pointSizeTotalOffset += pointSizeOffset;
     }
+    flushTriangle(pairing, state, target);
+    if (mode == GL_LINE_LOOP && counter >= 2)
+        drawLine(ver[index ^ 1], ver[2], state, target);
+    updateStencilMask(state);
 }
 
 void glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
@@ -1129,6 +3932,7 @@ void glEnableClientState(GLenum array)
     {
     case GL_COLOR_ARRAY: context->glUseColorArray = true; return;
     case GL_NORMAL_ARRAY: context->glUseNormalArray = true; return;
+    case GL_POINT_SIZE_ARRAY_OES: context->glUsePointSizeArray = true; return;
     case GL_TEXTURE_COORD_ARRAY: context->glTextureUnit[context->glClientActiveTexture].glUseTexCoordArray = true; return;
     case GL_VERTEX_ARRAY: context->glUseVertexArray = true; return;
     default: lastError = GL_INVALID_ENUM; return;
@@ -1137,12 +3941,16 @@ void glEnableClientState(GLenum array)
 
 void glFinish()
 {
-    ESP_LOGE(LIBRARY_NAME, "glFinish unimplemented");
+    resolveBins();
+    uploader.wait();
+    collectUploads();
 }
 
+//draws what is binned but, unlike glFinish, leaves glTexImage2DAsyncESP uploads running
 void glFlush()
 {
-    return;
+    resolveBins();
+    collectUploads();
 }
 
 void glFogf(GLenum pname, GLfloat param)
@@ -1242,9 +4050,9 @@ void glGetBooleanv(GLenum pname, GLboolean* data)
 {
     if (data == nullptr)
         return;
-    GLfloat res[4] = {MAXFLOAT, MAXFLOAT, MAXFLOAT, MAXFLOAT};
-    uint8_t count = glGet(pname, res);
-    for (int i = 0; i < 4 && res[i] != MAXFLOAT; i++)
+    GLfloat res[16];
+    const int count = min<int>(glGet(pname, res), 16);
+    for (int i = 0; i < count; i++)
         data[i] = res[i];
 }
 
@@ -1274,9 +4082,9 @@ void glGetFixedv(GLenum pname, GLfixed* params)
 {
     if (params == nullptr)
         return;
-    GLfloat res[4] = {MAXFLOAT, MAXFLOAT, MAXFLOAT, MAXFLOAT};
-    uint8_t count = glGet(pname, res);
-    for (int i = 0; i < 4 && res[i] != MAXFLOAT; i++)
+    GLfloat res[16];
+    const int count = min<int>(glGet(pname, res), 16);
+    for (int i = 0; i < count; i++)
         params[i] = res[i];
 }
 
@@ -1284,9 +4092,9 @@ void glGetFloatv(GLenum pname, GLfloat* data)
 {
     if (data == nullptr)
         return;
-    GLfloat res[16] = {MAXFLOAT, MAXFLOAT, MAXFLOAT, MAXFLOAT, MAXFLOAT, MAXFLOAT, MAXFLOAT, MAXFLOAT};
-    uint8_t count = glGet(pname, res);
-    for (int i = 0; i < 4 && res[i] != MAXFLOAT; i++)
+    GLfloat res[16];
+    const int count = min<int>(glGet(pname, res), 16);
+    for (int i = 0; i < count; i++)
         data[i] = res[i];
 }
 
@@ -1294,9 +4102,9 @@ void glGetIntegerv(GLenum pname, GLint* data)
 {
     if (data == nullptr)
         return;
-    GLfloat res[4] = {MAXFLOAT, MAXFLOAT, MAXFLOAT, MAXFLOAT};
-    uint8_t count = glGet(pname, res);
-    for (int i = 0; i < 4 && res[i] != MAXFLOAT; i++)
+    GLfloat res[16];
+    const int count = min<int>(glGet(pname, res), 16);
+    for (int i = 0; i < count; i++)
         data[i] = res[i];
 }
 
@@ -1396,7 +4204,7 @@ GLboolean glIsEnabled(GLenum cap)
     // case GL_COLOR_LOGIC_OP: break;
     // case GL_COLOR_MATERIAL: break;
     case GL_CULL_FACE: return context->glCullFace;
-    // case GL_DEPTH_TEST: break;
+    case GL_DEPTH_TEST: return context->glDepthTest;
     // case GL_DITHER: break;
     // case GL_FOG: break;
     // case GL_LIGHTING: break;
@@ -1404,17 +4212,20 @@ GLboolean glIsEnabled(GLenum cap)
     // case GL_MULTISAMPLE: break;
     // case GL_NORMALIZE: break;
     // case GL_POINT_SMOOTH: break;
+    case GL_POINT_SPRITE_OES: return context->glPointSprite;
     // case GL_POLYGON_OFFSET_FILL: break;
     // case GL_RESCALE_NORMAL: break;
     // case GL_SAMPLE_ALPHA_TO_COVERAGE: break;
     // case GL_SAMPLE_ALPHA_TO_ONE: break;
     // case GL_SAMPLE_COVERAGE: break;
-    // case GL_SCISSOR_TEST: break;
-    // case GL_STENCIL_TEST: break;
+    case GL_SCISSOR_TEST: return context->glScissorTest;
+    case GL_STENCIL_TEST: return context->glStencilTest;
     case GL_TEXTURE_2D: return context->glTextureUnit[context->glActiveTexture].glEnabled;
+    case GL_TILE_BINNING_ESP: return context->glTileBinning;
+    case GL_TEXEL_CACHE_ESP: return context->glTexelCache;
     default:
         ESP_LOGE(LIBRARY_NAME, "glSet Enum not implemented: %d", cap);
-        break;
+        return GL_FALSE;
     }
 }
 
@@ -1670,37 +4481,60 @@ void glOrthox(GLfixed l, GLfixed r, GLfixed b, GLfixed t, GLfixed n, GLfixed f)
 
 void glPixelStorei(GLenum pname, GLint param)
 {
-    ESP_LOGE(LIBRARY_NAME, "glPixelStorei unimplemented");
+    if (pname != GL_PACK_ALIGNMENT && pname != GL_UNPACK_ALIGNMENT)
+    {
+        lastError = GL_INVALID_ENUM;
+        return;
+    }
+    if (param != 1 && param != 2 && param != 4 && param != 8)
+    {
+        lastError = GL_INVALID_VALUE;
+        return;
+    }
+    if (pname == GL_PACK_ALIGNMENT)
+        context->glPackAlignment = param;
+    else
+        context->glUnpackAlignment = param;
 }
 
 void glPointParameterf(GLenum pname, GLfloat param)
 {
-    ESP_LOGE(LIBRARY_NAME, "glPointParameterf unimplemented");
+    glPointParameter(pname, &param, 1);
 }
 
 void glPointParameterfv(GLenum pname, const GLfloat* params)
 {
-    ESP_LOGE(LIBRARY_NAME, "glPointParameterfv unimplemented");
+    glPointParameter(pname, params, pname == GL_POINT_DISTANCE_ATTENUATION ? 3 : 1);
 }
 
 void glPointParameterx(GLenum pname, GLfixed param)
 {
-    ESP_LOGE(LIBRARY_NAME, "glPointParameterx unimplemented");
+    const GLfloat value = param * oneDiv65536;
+    glPointParameter(pname, &value, 1);
 }
 
 void glPointParameterxv(GLenum pname, const GLfixed* params)
 {
-    ESP_LOGE(LIBRARY_NAME, "glPointParameterxv unimplemented");
+    const uint8_t count = pname == GL_POINT_DISTANCE_ATTENUATION ? 3 : 1;
+    GLfloat values[3];
+    for (uint8_t i = 0; i < count; i++)
+        values[i] = params[i] * oneDiv65536;
+    glPointParameter(pname, values, count);
 }
 
 void glPointSize(GLfloat size)
 {
-    ESP_LOGE(LIBRARY_NAME, "glPointSize unimplemented");
+    if (size <= 0.f)
+    {
+        lastError = GL_INVALID_VALUE;
+        return;
+    }
+    context->glPointSize = size;
 }
 
 void glPointSizex(GLfixed size)
 {
-    ESP_LOGE(LIBRARY_NAME, "glPointSizex unimplemented");
+    glPointSize(size * oneDiv65536);
 }
 
 void glPolygonOffset(GLfloat factor, GLfloat units)
@@ -1827,7 +4661,15 @@ void glScalex(GLfixed x, GLfixed y, GLfixed z)
 
 void glScissor(GLint x, GLint y, GLsizei width, GLsizei height)
 {
-    ESP_LOGE(LIBRARY_NAME, "glScissor unimplemented");
+    if (width < 0 || height < 0)
+    {
+        lastError = GL_INVALID_VALUE;
+        return;
+    }
+    context->glScissorX = x;
+    context->glScissorY = y;
+    context->glScissorWidth = width;
+    context->glScissorHeight = height;
 }
 
 void glShadeModel(GLenum mode)
@@ -1837,17 +4679,41 @@ void glShadeModel(GLenum mode)
 
 void glStencilFunc(GLenum func, GLint ref, GLuint mask)
 {
-    ESP_LOGE(LIBRARY_NAME, "glStencilFunc unimplemented");
+    switch (func)
+    {
+    case GL_NEVER:
+    case GL_LESS:
+    case GL_LEQUAL:
+    case GL_EQUAL:
+    case GL_GREATER:
+    case GL_NOTEQUAL:
+    case GL_GEQUAL:
+    case GL_ALWAYS:
+        context->glStencilFunc = func;
+        context->glStencilRef = std::clamp(ref, 0, static_cast<int>(std::pow(2, context->config->stencil) - 1));
+        context->glStencilValueMask = mask;
+        return;
+    default:
+        lastError = GL_INVALID_ENUM;
+        return;
+    }
 }
 
 void glStencilMask(GLuint mask)
 {
-    ESP_LOGE(LIBRARY_NAME, "glStencilMask unimplemented");
+    context->glStencilWriteMask = mask;
 }
 
 void glStencilOp(GLenum fail, GLenum zfail, GLenum zpass)
 {
-    ESP_LOGE(LIBRARY_NAME, "glStencilOp unimplemented");
+    if (!isStencilOp(fail) || !isStencilOp(zfail) || !isStencilOp(zpass))
+    {
+        lastError = GL_INVALID_ENUM;
+        return;
+    }
+    context->glStencilFail = fail;
+    context->glStencilPassDepthFail = zfail;
+    context->glStencilPassDepthPass = zpass;
 }
 
 void glTexCoordPointer(GLint size, GLenum type, GLsizei stride, const void* pointer)
@@ -1872,32 +4738,32 @@ void glTexCoordPointer(GLint size, GLenum type, GLsizei stride, const void* poin
 
 void glTexEnvf(GLenum target, GLenum pname, GLfloat param)
 {
-    ESP_LOGE(LIBRARY_NAME, "glTexEnvf unimplemented");
+    glTexEnv(target, pname, param);
 }
 
 void glTexEnvfv(GLenum target, GLenum pname, const GLfloat* params)
 {
-    ESP_LOGE(LIBRARY_NAME, "glTexEnvfv unimplemented");
+    glTexEnv(target, pname, params[0]);
 }
 
 void glTexEnvi(GLenum target, GLenum pname, GLint param)
 {
-    ESP_LOGE(LIBRARY_NAME, "glTexEnvi unimplemented");
+    glTexEnv(target, pname, param);
 }
 
 void glTexEnviv(GLenum target, GLenum pname, const GLint* params)
 {
-    ESP_LOGE(LIBRARY_NAME, "glTexEnviv unimplemented");
+    glTexEnv(target, pname, params[0]);
 }
 
 void glTexEnvx(GLenum target, GLenum pname, GLfixed param)
 {
-    ESP_LOGE(LIBRARY_NAME, "glTexEnvx unimplemented");
+    glTexEnv(target, pname, param);
 }
 
 void glTexEnvxv(GLenum target, GLenum pname, const GLfixed* params)
 {
-    ESP_LOGE(LIBRARY_NAME, "glTexEnvxv unimplemented");
+    glTexEnv(target, pname, params[0]);
 }
 
 void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border,
@@ -1908,7 +4774,7 @@ void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei widt
         lastError = GL_INVALID_ENUM;
         return;
     }
-    if (level < 0)
+    if (level < 0 || level > glGetMaxTextureLevel)
     {
         lastError = GL_INVALID_VALUE;
         return;
@@ -1918,41 +4784,37 @@ void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei widt
         lastError = GL_INVALID_VALUE;
         return;
     }
-    if (internalformat != format)
+    if (width < 0 || height < 0 || width > glGetMaxTextureSize || height > glGetMaxTextureSize)
     {
-        lastError = GL_INVALID_OPERATION;
+        lastError = GL_INVALID_VALUE;
         return;
     }
-    if (internalformat != GL_RGBA && internalformat != GL_RGB && internalformat != GL_ALPHA &&
-        internalformat != GL_LUMINANCE && internalformat != GL_LUMINANCE_ALPHA)
+    if (internalformat != format)
     {
-        lastError = GL_INVALID_ENUM;
+        lastError = GL_INVALID_OPERATION;
         return;
     }
-    if (type != GL_UNSIGNED_BYTE || level != 0 || internalformat != GL_RGBA)
-    {
-        ESP_LOGE(LIBRARY_NAME, "Just don't");
-    }
+    Context::Texture::Storage storage;
+    if (!textureStorage(format, type, storage))
+        return;
+    resolveBins();
     Context::Texture& tex = context->glTextures[context->glTextureUnit[context->glActiveTexture].glBoundTexture];
-    tex.width = width;
-    tex.height = height;
-
-    uint8_t size = 0;
-    switch (internalformat)
+    finishUploads(tex);
+    if (level > static_cast<GLint>(tex.mipmaps.size()))
+        tex.mipmaps.resize(level);
+    Context::Texture& image = level == 0 ? tex : tex.mipmaps[level - 1];
+    allocateLevel(image, width, height, internalformat, convertedStorage(storage, tex.storageType), tex.tiled);
+    if (level == 0)
+        freePalette(tex);
+    if (!image.data)
     {
-    case GL_ALPHA: size = sizeof(Context::Texture::Alpha); break;
-    case GL_RGB: size = sizeof(Context::Texture::RGB); break;
-    case GL_RGBA: size = sizeof(Context::Texture::RGBA); break;
-    case GL_LUMINANCE: size = sizeof(Context::Texture::Luminance); break;
-    case GL_LUMINANCE_ALPHA: size = sizeof(Context::Texture::LuminanceAlpha); break;
+        lastError = GL_OUT_OF_MEMORY;
+        return;
     }
-    if (!tex.data)
-        tex.data = heap_caps_malloc(width * height * size, MALLOC_CAP_SPIRAM);
     if (pixels)
-    {
-        for (uint32_t i = 0; i < width * height * size; i++)
-            static_cast<uint8_t*>(tex.data)[i] = static_cast<const uint8_t*>(pixels)[i];
-    }
+        writeTexels(image, 0, 0, width, height, pixels, storage);
+    if (level == 0 && tex.generateMipmap)
+        generateMipmaps(tex);
 }
 
 void glTexParameterf(GLenum target, GLenum pname, GLfloat param)
@@ -1962,6 +4824,12 @@ void glTexParameterf(GLenum target, GLenum pname, GLfloat param)
 
 void glTexParameterfv(GLenum target, GLenum pname, const GLfloat* params)
 {
+    if (pname == GL_TEXTURE_CROP_RECT_OES)
+    {
+        const GLint rect[4] = { static_cast<GLint>(params[0]), static_cast<GLint>(params[1]), static_cast<GLint>(params[2]), static_cast<GLint>(params[3]) };
+        glTexCropRect(target, rect);
+        return;
+    }
     glTexParameter(target, pname, params[0]);
 }
 
@@ -1972,6 +4840,11 @@ void glTexParameteri(GLenum target, GLenum pname, GLint param)
 
 void glTexParameteriv(GLenum target, GLenum pname, const GLint* params)
 {
+    if (pname == GL_TEXTURE_CROP_RECT_OES)
+    {
+        glTexCropRect(target, params);
+        return;
+    }
     glTexParameter(target, pname, params[0]);
 }
 
@@ -1982,6 +4855,12 @@ void glTexParameterx(GLenum target, GLenum pname, GLfixed param)
 
 void glTexParameterxv(GLenum target, GLenum pname, const GLfixed* params)
 {
+    if (pname == GL_TEXTURE_CROP_RECT_OES)
+    {
+        const GLint rect[4] = { params[0] >> 16, params[1] >> 16, params[2] >> 16, params[3] >> 16 };
+        glTexCropRect(target, rect);
+        return;
+    }
     glTexParameter(target, pname, params[0]);
 }
 
@@ -1993,60 +4872,44 @@ void glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, G
         lastError = GL_INVALID_ENUM;
         return;
     }
-    if (level < 0)
+    if (level < 0 || level > glGetMaxTextureLevel)
     {
         lastError = GL_INVALID_VALUE;
         return;
     }
-    if (format != GL_RGBA && format != GL_RGB && format != GL_ALPHA &&
-        format != GL_LUMINANCE && format != GL_LUMINANCE_ALPHA)
-    {
-        lastError = GL_INVALID_ENUM;
+    Context::Texture::Storage storage;
+    if (!textureStorage(format, type, storage))
         return;
-    }
-    if (type != GL_UNSIGNED_BYTE || level != 0 || format != GL_RGBA)
-    {
-        ESP_LOGE(LIBRARY_NAME, "Just don't");
-    }
     if (width < 0 || height < 0)
     {
         lastError = GL_INVALID_VALUE;
         return;
     }
-    Context::Texture& tex = context->glTextures[context->glTextureUnit[context->glActiveTexture].glBoundTexture];
-    if (xoffset < 0 || xoffset + width > tex.width || yoffset < 0 || yoffset + height > tex.height)
+    Context::Texture& base = context->glTextures[context->glTextureUnit[context->glActiveTexture].glBoundTexture];
+    finishUploads(base);
+    Context::Texture* image = textureLevel(base, level);
+    if (!image)
     {
-        lastError = GL_INVALID_VALUE;
+        lastError = GL_INVALID_OPERATION;
         return;
     }
-
-    uint8_t size = 0;
-    switch (format)
-    {
-    case GL_ALPHA: size = sizeof(Context::Texture::Alpha); break;
-    case GL_RGB: size = sizeof(Context::Texture::RGB); break;
-    case GL_RGBA: size = sizeof(Context::Texture::RGBA); break;
-    case GL_LUMINANCE: size = sizeof(Context::Texture::Luminance); break;
-    case GL_LUMINANCE_ALPHA: size = sizeof(Context::Texture::LuminanceAlpha); break;
-    }
-    if (!tex.data)
+    Context::Texture& tex = *image;
+    if (format != tex.internalformat || (storage != tex.storage && convertedStorage(storage, base.storageType) != tex.storage))
     {
         lastError = GL_INVALID_OPERATION;
         return;
     }
-    if (pixels)
+    if (xoffset < 0 || xoffset + width > tex.width || yoffset < 0 || yoffset + height > tex.height)
     {
-        for (int16_t i = 0; i < width; i++)
-            for (int16_t j = 0; j < height; j++)
-            {
-                for (int8_t k = 0; k < size; k++)
-                {
-                    uint32_t src = (j * width + i) * size + k;
-                    uint32_t dst = ((j + yoffset) * tex.width + xoffset + i) * size + k;
-                    static_cast<uint8_t*>(tex.data)[dst] = static_cast<const uint8_t*>(pixels)[src];
-                }
-            }
+        lastError = GL_INVALID_VALUE;
+        return;
     }
+
+    resolveBins();
+    if (pixels)
+        writeTexels(tex, xoffset, yoffset, width, height, pixels, storage);
+    if (level == 0 && base.generateMipmap)
+        generateMipmaps(base);
 }
 
 void glTranslatef(GLfloat x, GLfloat y, GLfloat z)
@@ -2176,5 +5039,203 @@ void glFramebufferRenderbufferOES(GLenum target, GLenum attachment, GLenum rende
 
 void glGenerateMipmapOES(GLenum target)
 {
-    ESP_LOGE(LIBRARY_NAME, "glGenerateMipmap not implemented");
+    if (target != GL_TEXTURE_2D)
+    {
+        lastError = GL_INVALID_ENUM;
+        return;
+    }
+    Context::Texture& tex = context->glTextures[context->glTextureUnit[context->glActiveTexture].glBoundTexture];
+    finishUploads(tex);
+    if (!tex.data || compressedStorage(tex.storage))
+    {
+        lastError = GL_INVALID_OPERATION;
+        return;
+    }
+    resolveBins();
+    generateMipmaps(tex);
+}
+
+//OES Extensions
+void glPointSizePointerOES(GLenum type, GLsizei stride, const void* pointer)
+{
+    if (stride < 0)
+    {
+        lastError = GL_INVALID_VALUE;
+        return;
+    }
+    if (type != GL_FLOAT && type != GL_FIXED)
+    {
+        lastError = GL_INVALID_ENUM;
+        return;
+    }
+    context->glPointSizePointerType = type;
+    context->glPointSizePointerStride = stride;
+    context->glPointSizePointer = pointer;
+}
+
+void glDrawTexsOES(GLshort x, GLshort y, GLshort z, GLshort width, GLshort height)
+{
+    drawTexture(x, y, z, width, height);
+}
+
+void glDrawTexiOES(GLint x, GLint y, GLint z, GLint width, GLint height)
+{
+    drawTexture(x, y, z, width, height);
+}
+
+void glDrawTexxOES(GLfixed x, GLfixed y, GLfixed z, GLfixed width, GLfixed height)
+{
+    drawTexture(x * oneDiv65536, y * oneDiv65536, z * oneDiv65536, width * oneDiv65536, height * oneDiv65536);
+}
+
+void glDrawTexfOES(GLfloat x, GLfloat y, GLfloat z, GLfloat width, GLfloat height)
+{
+    drawTexture(x, y, z, width, height);
+}
+
+void glDrawTexsvOES(const GLshort* coords)
+{
+    drawTexture(coords[0], coords[1], coords[2], coords[3], coords[4]);
+}
+
+void glDrawTexivOES(const GLint* coords)
+{
+    drawTexture(coords[0], coords[1], coords[2], coords[3], coords[4]);
+}
+
+void glDrawTexxvOES(const GLfixed* coords)
+{
+    glDrawTexxOES(coords[0], coords[1], coords[2], coords[3], coords[4]);
+}
+
+void glDrawTexfvOES(const GLfloat* coords)
+{
+    drawTexture(coords[0], coords[1], coords[2], coords[3], coords[4]);
+}
+
+void releaseContextState(const Context* con)
+{
+    if (binner.owner != con)
+        return;
+    //whatever is still binned would be drawn into a frame buffer that is going away
+    for (std::vector<uint32_t>& bin : binner.bins)
+        bin.clear();
+    binner.triangles.clear();
+    binner.states.clear();
+    binner.pendingClear = false;
+    binner.pendingDepthClear = false;
+    binner.usesDepth = false;
+    binner.usesStencil = false;
+    freeTileMemory();
+    binner.bins.clear();
+    binner.tilesX = 0;
+    binner.tilesY = 0;
+    binner.owner = nullptr;
+}
+
+//ESP32 Extensions
+void glRasterWorkersESP(GLuint count)
+{
+    if (count < 1 || count > glGetMaxRasterWorkers)
+    {
+        lastError = GL_INVALID_VALUE;
+        return;
+    }
+    resolveBins();
+    scheduler.setWorkers(count);
+}
+void glTexImage2DAsyncESP(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border,
+    GLenum format, GLenum type, GLenum encoding, GLsizei imageSize, const void* data)
+{
+    if (target != GL_TEXTURE_2D)
+    {
+        lastError = GL_INVALID_ENUM;
+        return;
+    }
+    if (encoding != GL_NO_ENCODING_ESP && encoding != GL_RLE_ESP && encoding != GL_QOI_ESP)
+    {
+        lastError = GL_INVALID_ENUM;
+        return;
+    }
+    if (level < 0 || level > glGetMaxTextureLevel || border != 0 || width < 0 || height < 0 || width > glGetMaxTextureSize ||
+        height > glGetMaxTextureSize || imageSize < 0 || !data)
+    {
+        lastError = GL_INVALID_VALUE;
+        return;
+    }
+    if (static_cast<GLenum>(internalformat) != format)
+    {
+        lastError = GL_INVALID_OPERATION;
+        return;
+    }
+    Context::Texture::Storage storage;
+    if (!textureStorage(format, type, storage))
+        return;
+    if (encoding == GL_QOI_ESP && storage != Context::Texture::RGBA8888 && storage != Context::Texture::RGB888)
+    {
+        lastError = GL_INVALID_OPERATION;
+        return;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    const uint32_t stride = uploadStride(width, storage);
+    const uint32_t size = imageSize;
+    //a raw image has to hold every row, an RLE one is only known to be short while decoding
+    //the QOI header is checked here so a mismatch is reported at the call
+    if (encoding == GL_NO_ENCODING_ESP && height && size < stride * (height - 1) + width * texelSize(storage))
+    {
+        lastError = GL_INVALID_VALUE;
+        return;
+    }
+    auto bigEndian = [](const uint8_t* word) { return static_cast<uint32_t>(word[0]) << 24 | word[1] << 16 | word[2] << 8 | word[3]; };
+    if (encoding == GL_QOI_ESP && (size < qoiHeaderSize + qoiEndMarkerSize || memcmp(bytes, "qoif", 4) ||
+        bigEndian(bytes + 4) != static_cast<uint32_t>(width) || bigEndian(bytes + 8) != static_cast<uint32_t>(height)))
+    {
+        lastError = GL_INVALID_VALUE;
+        return;
+    }
+
+    resolveBins();
+    Context::Texture& tex = context->glTextures[context->glTextureUnit[context->glActiveTexture].glBoundTexture];
+    finishUploads(tex);
+    if (level > static_cast<GLint>(tex.mipmaps.size()))
+        tex.mipmaps.resize(level);
+    Context::Texture& image = level == 0 ? tex : tex.mipmaps[level - 1];
+    allocateLevel(image, width, height, internalformat, convertedStorage(storage, tex.storageType), tex.tiled);
+    if (level == 0)
+        freePalette(tex);
+    if (!image.data)
+    {
+        lastError = GL_OUT_OF_MEMORY;
+        return;
+    }
+    if (!width || !height)
+        return;
+
+    //every level is allocated here, the background task only writes texels
+    TextureUpload* job = new TextureUpload();
+    job->texture = &tex;
+    job->levels.push_back(levelLayout(image));
+    if (level == 0 && tex.generateMipmap)
+    {
+        allocateMipmaps(tex);
+        for (const Context::Texture& mipmap : tex.mipmaps)
+            job->levels.push_back(levelLayout(mipmap));
+    }
+    job->data = bytes;
+    job->size = size;
+    job->encoding = encoding;
+    job->upload = storage;
+    job->stride = stride;
+    if (encoding != GL_NO_ENCODING_ESP)
+        job->row.resize(width * texelSize(storage));
+    tex.uploading = true;
+    uploads.push_back(job);
+    uploader.post(uploadTexture, job);
+}
+
+GLboolean glIsTextureReadyESP(GLuint texture)
+{
+    collectUploads();
+    const auto tex = context->glTextures.find(texture);
+    return tex != context->glTextures.end() && !tex->second.uploading ? GL_TRUE : GL_FALSE;
 }
@@ -567,4 +567,78 @@ void glGenFramebuffersOES(GLsizei n, GLuint * framebuffers);
 GLenum glCheckFramebufferStatusOES(GLenum target);
 void glFramebufferTexture2DOES(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
 void glFramebufferRenderbufferOES(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
-void glGenerateMipmapOES(GLenum target);
\ No newline at end of file
+void glGenerateMipmapOES(GLenum target);
+
+//OES_point_sprite
+#define GL_POINT_SPRITE_OES 0x8861
+#define GL_COORD_REPLACE_OES 0x8862
+//OES_point_size_array
+#define GL_POINT_SIZE_ARRAY_OES 0x8B9C
+#define GL_POINT_SIZE_ARRAY_TYPE_OES 0x898A
+#define GL_POINT_SIZE_ARRAY_STRIDE_OES 0x898B
+#define GL_POINT_SIZE_ARRAY_POINTER_OES 0x898C
+#define GL_POINT_SIZE_ARRAY_BUFFER_BINDING_OES 0x8B9F
+
+void glPointSizePointerOES(GLenum type, GLsizei stride, const void* pointer);
+
+//OES_draw_texture
+#define GL_TEXTURE_CROP_RECT_OES 0x8B9D
+
+void glDrawTexsOES(GLshort x, GLshort y, GLshort z, GLshort width, GLshort height);
+void glDrawTexiOES(GLint x, GLint y, GLint z, GLint width, GLint height);
+void glDrawTexxOES(GLfixed x, GLfixed y, GLfixed z, GLfixed width, GLfixed height);
+void glDrawTexfOES(GLfloat x, GLfloat y, GLfloat z, GLfloat width, GLfloat height);
+void glDrawTexsvOES(const GLshort* coords);
+void glDrawTexivOES(const GLint* coords);
+void glDrawTexxvOES(const GLfixed* coords);
+void glDrawTexfvOES(const GLfloat* coords);
+
+//OES_compressed_paletted_texture
+#define GL_PALETTE4_RGB8_OES 0x8B90
+#define GL_PALETTE4_RGBA8_OES 0x8B91
+#define GL_PALETTE4_R5_G6_B5_OES 0x8B92
+#define GL_PALETTE4_RGBA4_OES 0x8B93
+#define GL_PALETTE4_RGB5_A1_OES 0x8B94
+#define GL_PALETTE8_RGB8_OES 0x8B95
+#define GL_PALETTE8_RGBA8_OES 0x8B96
+#define GL_PALETTE8_R5_G6_B5_OES 0x8B97
+#define GL_PALETTE8_RGBA4_OES 0x8B98
+#define GL_PALETTE8_RGB5_A1_OES 0x8B99
+
+//OES_compressed_ETC1_RGB8_texture
+#define GL_ETC1_RGB8_OES 0x8D64
+
+//ESP32 Extensions
+//the 0x8FF0 - 0x8FF8 values are not registered with Khronos and may be used by other vendors' extensions, only pass
+//them to this library
+//defer triangles into screen tiles until glFlush/glFinish/eglSwapBuffers
+#define GL_TILE_BINNING_ESP 0x8FF0
+//number of cores resolving the tiles, the calling thread included
+#define GL_RASTER_WORKERS_ESP 0x8FF1
+//texture parameter, store the bound texture in blocks so neighbouring rows share cache lines, off by default, on the
+//host bench/ samples rotated sprites slower tiled than row major, enable it only where bench/ shows it faster on the ESP32
+#define GL_TEXTURE_TILED_ESP 0x8FF2
+//sample textures through a small cache of decoded texel blocks in internal RAM, off by default, on the host bench/
+//samples slower through it in every layout, enable it only where bench/ shows it faster on the ESP32
+#define GL_TEXEL_CACHE_ESP 0x8FF3
+//texel fetches that hit and missed the cache since GL_TEXEL_CACHE_ESP was last enabled, as of the last time the bins
+//were resolved by glFlush/glFinish/eglSwapBuffers or a state change that needs it
+#define GL_TEXEL_CACHE_HITS_ESP 0x8FF4
+#define GL_TEXEL_CACHE_MISSES_ESP 0x8FF5
+//texture parameter, GL_UNSIGNED_SHORT_5_6_5 stores GL_RGB and GL_UNSIGNED_SHORT_4_4_4_4 or GL_UNSIGNED_SHORT_5_5_5_1
+//GL_RGBA uploads of GL_UNSIGNED_BYTE texels converted to that type, GL_UNSIGNED_BYTE stores them as given
+#define GL_TEXTURE_STORAGE_TYPE_ESP 0x8FF6
+//encodings of glTexImage2DAsyncESP data, GL_NO_ENCODING_ESP rows of texels as glTexImage2D takes them
+#define GL_NO_ENCODING_ESP 0
+//packets of a control byte c, bit 7 set repeats the one texel after it (c & 0x7F) + 1 times, clear copies c + 1 texels
+#define GL_RLE_ESP 0x8FF7
+//a whole QOI image, format GL_RGB or GL_RGBA and type GL_UNSIGNED_BYTE
+#define GL_QOI_ESP 0x8FF8
+
+void glRasterWorkersESP(GLuint count);
+//glTexImage2D copying or decoding data on a background task, data has to stay valid until the texture is ready
+//the texture is not sampled until then, draws act as if it were not bound
+void glTexImage2DAsyncESP(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border,
+    GLenum format, GLenum type, GLenum encoding, GLsizei imageSize, const void* data);
+//GL_FALSE while an upload of glTexImage2DAsyncESP into the texture is pending, and for names that are not textures
+GLboolean glIsTextureReadyESP(GLuint texture);
\ No newline at end of file
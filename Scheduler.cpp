@@ -0,0 +1,345 @@
+#include "Scheduler.h"
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#else
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#endif
+
+#ifdef ESP_PLATFORM
+#define workerStackSize 4096
+#define backgroundQueueLength 16
+
+struct Scheduler::Sync
+{
+    SemaphoreHandle_t done;
+    bool quit = false;
+};
+
+struct Scheduler::Worker
+{
+    Scheduler* owner;
+    uint8_t index;
+    TaskHandle_t task = nullptr;
+};
+
+namespace
+{
+    void workerTask(void* arg)
+    {
+        Scheduler::Worker* worker = static_cast<Scheduler::Worker*>(arg);
+        Scheduler* owner = worker->owner;
+        while (true)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            if (owner->sync->quit)
+                break;
+            owner->job(owner->data, worker->index);
+            xSemaphoreGive(owner->sync->done);
+        }
+        xSemaphoreGive(owner->sync->done);
+        vTaskDelete(nullptr);
+    }
+}
+
+Scheduler::Scheduler()
+{
+    sync = new Sync();
+    sync->done = xSemaphoreCreateCounting(255, 0);
+}
+
+Scheduler::~Scheduler()
+{
+    setWorkers(1);
+    vSemaphoreDelete(sync->done);
+    delete sync;
+}
+
+void Scheduler::setWorkers(uint8_t count)
+{
+    if (count < 1)
+        count = 1;
+    if (count == workerCount())
+        return;
+    sync->quit = true;
+    for (Worker* worker : workers)
+        xTaskNotifyGive(worker->task);
+    for (Worker* worker : workers)
+    {
+        xSemaphoreTake(sync->done, portMAX_DELAY);
+        delete worker;
+    }
+    workers.clear();
+    sync->quit = false;
+
+    //spread the extra workers over the cores not running the caller first
+    const BaseType_t callerCore = xPortGetCoreID();
+    for (uint8_t i = 1; i < count; i++)
+    {
+        Worker* worker = new Worker{ this, i };
+        const BaseType_t core = (callerCore + i) % portNUM_PROCESSORS;
+        xTaskCreatePinnedToCore(workerTask, "GLES worker", workerStackSize, worker, uxTaskPriorityGet(nullptr), &worker->task, core);
+        workers.push_back(worker);
+    }
+}
+
+void Scheduler::run(Job job, void* data)
+{
+    this->job = job;
+    this->data = data;
+    for (Worker* worker : workers)
+        xTaskNotifyGive(worker->task);
+    job(data, 0);
+    for (size_t i = 0; i < workers.size(); i++)
+        xSemaphoreTake(sync->done, portMAX_DELAY);
+}
+
+struct BackgroundQueue::Sync
+{
+    struct Entry
+    {
+        Job job;
+        void* data;
+    };
+    QueueHandle_t queue;
+    SemaphoreHandle_t done;
+    TaskHandle_t task = nullptr;
+    uint32_t posted = 0;
+    uint32_t finished = 0;
+};
+
+namespace
+{
+    void backgroundTask(void* arg)
+    {
+        BackgroundQueue::Sync* sync = static_cast<BackgroundQueue::Sync*>(arg);
+        BackgroundQueue::Sync::Entry entry;
+        while (true)
+        {
+            xQueueReceive(sync->queue, &entry, portMAX_DELAY);
+            //a null job is the request to quit from the destructor
+            if (!entry.job)
+                break;
+            entry.job(entry.data);
+            xSemaphoreGive(sync->done);
+        }
+        xSemaphoreGive(sync->done);
+        vTaskDelete(nullptr);
+    }
+}
+
+BackgroundQueue::BackgroundQueue()
+{
+    sync = new Sync();
+    sync->queue = xQueueCreate(backgroundQueueLength, sizeof(Sync::Entry));
+    //one give per finished job, wait() takes them all however long ago they were given
+    sync->done = xSemaphoreCreateCounting(~static_cast<UBaseType_t>(0), 0);
+}
+
+BackgroundQueue::~BackgroundQueue()
+{
+    wait();
+    if (sync->task)
+    {
+        const Sync::Entry quit = { nullptr, nullptr };
+        xQueueSend(sync->queue, &quit, portMAX_DELAY);
+        xSemaphoreTake(sync->done, portMAX_DELAY);
+    }
+    vQueueDelete(sync->queue);
+    vSemaphoreDelete(sync->done);
+    delete sync;
+}
+
+void BackgroundQueue::post(Job job, void* data)
+{
+    if (!sync->task)
+    {
+        const UBaseType_t priority = uxTaskPriorityGet(nullptr);
+        const BaseType_t core = (xPortGetCoreID() + 1) % portNUM_PROCESSORS;
+        xTaskCreatePinnedToCore(backgroundTask, "GLES background", workerStackSize, sync,
+            priority > tskIDLE_PRIORITY + 1 ? priority - 1 : tskIDLE_PRIORITY + 1, &sync->task, core);
+    }
+    //a full queue blocks the caller until the oldest job is taken
+    const Sync::Entry entry = { job, data };
+    xQueueSend(sync->queue, &entry, portMAX_DELAY);
+    sync->posted++;
+}
+
+void BackgroundQueue::wait()
+{
+    for (; sync->finished != sync->posted; sync->finished++)
+        xSemaphoreTake(sync->done, portMAX_DELAY);
+}
+#else
+struct Scheduler::Sync
+{
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    uint32_t generation = 0;
+    uint8_t pending = 0;
+    bool quit = false;
+};
+
+struct Scheduler::Worker
+{
+    Scheduler* owner;
+    uint8_t index;
+    std::thread thread{};
+};
+
+namespace
+{
+    void workerThread(Scheduler::Worker* worker, uint32_t generation)
+    {
+        Scheduler* owner = worker->owner;
+        Scheduler::Sync& sync = *owner->sync;
+        while (true)
+        {
+            std::unique_lock<std::mutex> lock(sync.mutex);
+            sync.wake.wait(lock, [&] { return sync.quit || sync.generation != generation; });
+            if (sync.quit)
+                return;
+            generation = sync.generation;
+            lock.unlock();
+            owner->job(owner->data, worker->index);
+            lock.lock();
+            if (--sync.pending == 0)
+                sync.finished.notify_one();
+        }
+    }
+}
+
+Scheduler::Scheduler()
+{
+    sync = new Sync();
+}
+
+Scheduler::~Scheduler()
+{
+    setWorkers(1);
+    delete sync;
+}
+
+void Scheduler::setWorkers(uint8_t count)
+{
+    if (count < 1)
+        count = 1;
+    if (count == workerCount())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(sync->mutex);
+        sync->quit = true;
+    }
+    sync->wake.notify_all();
+    for (Worker* worker : workers)
+    {
+        worker->thread.join();
+        delete worker;
+    }
+    workers.clear();
+    sync->quit = false;
+
+    for (uint8_t i = 1; i < count; i++)
+    {
+        Worker* worker = new Worker{ this, i };
+        worker->thread = std::thread(workerThread, worker, sync->generation);
+        workers.push_back(worker);
+    }
+}
+
+void Scheduler::run(Job job, void* data)
+{
+    {
+        std::lock_guard<std::mutex> lock(sync->mutex);
+        this->job = job;
+        this->data = data;
+        sync->pending = workers.size();
+        sync->generation++;
+    }
+    sync->wake.notify_all();
+    job(data, 0);
+    std::unique_lock<std::mutex> lock(sync->mutex);
+    sync->finished.wait(lock, [&] { return sync->pending == 0; });
+}
+
+struct BackgroundQueue::Sync
+{
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::deque<std::pair<Job, void*>> jobs;
+    std::thread thread;
+    //a job has been taken from jobs but has not returned yet
+    bool running = false;
+    bool quit = false;
+};
+
+namespace
+{
+    void backgroundThread(BackgroundQueue::Sync* sync)
+    {
+        std::unique_lock<std::mutex> lock(sync->mutex);
+        while (true)
+        {
+            sync->wake.wait(lock, [&] { return sync->quit || !sync->jobs.empty(); });
+            if (sync->jobs.empty())
+                return;
+            const std::pair<BackgroundQueue::Job, void*> job = sync->jobs.front();
+            sync->jobs.pop_front();
+            sync->running = true;
+            lock.unlock();
+            job.first(job.second);
+            lock.lock();
+            sync->running = false;
+            if (sync->jobs.empty())
+                sync->finished.notify_all();
+        }
+    }
+}
+
+BackgroundQueue::BackgroundQueue()
+{
+    sync = new Sync();
+}
+
+BackgroundQueue::~BackgroundQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(sync->mutex);
+        sync->quit = true;
+    }
+    sync->wake.notify_one();
+    if (sync->thread.joinable())
+        sync->thread.join();
+    delete sync;
+}
+
+void BackgroundQueue::post(Job job, void* data)
+{
+    {
+        std::lock_guard<std::mutex> lock(sync->mutex);
+        sync->jobs.emplace_back(job, data);
+        if (!sync->thread.joinable())
+            sync->thread = std::thread(backgroundThread, sync);
+    }
+    sync->wake.notify_one();
+}
+
+void BackgroundQueue::wait()
+{
+    std::unique_lock<std::mutex> lock(sync->mutex);
+    sync->finished.wait(lock, [&] { return sync->jobs.empty() && !sync->running; });
+}
+#endif
+
+uint8_t Scheduler::workerCount() const
+{
+    return workers.size() + 1;
+}
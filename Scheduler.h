@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+//Runs the same job on several cores at once, the calling thread always acts as worker 0.
+//Workers are FreeRTOS tasks on the ESP32 and std::threads on other platforms.
+struct Scheduler
+{
+    typedef void (*Job)(void* data, uint8_t worker);
+    struct Worker;
+    struct Sync;
+
+    std::vector<Worker*> workers;
+    Sync* sync = nullptr;
+    Job job = nullptr;
+    void* data = nullptr;
+
+    Scheduler();
+    ~Scheduler();
+    //total number of threads taking part in run(), including the caller
+    void setWorkers(uint8_t count);
+    uint8_t workerCount() const;
+    //blocks until every worker has returned from job
+    void run(Job job, void* data);
+};
+
+//Runs jobs one after another in the order they were posted on one background thread, started with the first job.
+//On the ESP32 it is a FreeRTOS task on the core not running the caller, one priority level below it.
+struct BackgroundQueue
+{
+    typedef void (*Job)(void* data);
+    struct Sync;
+
+    Sync* sync = nullptr;
+
+    BackgroundQueue();
+    ~BackgroundQueue();
+    //returns at once, job runs after every job posted before it
+    void post(Job job, void* data);
+    //blocks until every posted job has returned
+    void wait();
+};
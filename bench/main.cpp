@@ -0,0 +1,801 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "GLES.h"
+#include "Context.h"
+
+//host build of the rasterizer, checks that the optional paths draw what the plain ones do and times the fill rate
+//usage: gles_bench [--check]
+extern Context* context;
+
+namespace
+{
+    const uint16_t width = 320;
+    const uint16_t height = 240;
+    const Config config = { 5, 6, 5, 0, 16, 8, 0, 0, 0, 0, 0 };
+    const Config colorOnly = { 5, 6, 5, 0, 0, 0, 0, 0, 0, 0, 0 };
+    const Config withAlpha = { 5, 6, 5, 8, 16, 8, 0, 0, 0, 0, 0 };
+    bool firstFrameBuffer = true;
+
+    //what eglCreateWindowSurface and eglMakeCurrent set up on the ESP32
+    void createSurface(Context& surface, uint16_t surfaceWidth, uint16_t surfaceHeight)
+    {
+        surface.width = surfaceWidth;
+        surface.height = surfaceHeight;
+        surface.createFrameBuffer();
+        surface.createDepthBuffer();
+        surface.createStencilBuffer();
+        surface.createAlphaBuffer();
+        surface.initViewport();
+        surface.surfaceFirstFrameBuffer = &firstFrameBuffer;
+    }
+    void makeCurrent(Context* con)
+    {
+        glFlush();
+        context = con;
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+    }
+
+    std::vector<uint16_t> frame()
+    {
+        glFinish();
+        return std::vector<uint16_t>(context->pixels.first, context->pixels.first + width * height);
+    }
+    uint16_t pixel(int32_t x, int32_t y)
+    {
+        glFinish();
+        return context->pixels.first[(height - 1 - y) * width + x];
+    }
+    void resetState()
+    {
+        glDisable(GL_TILE_BINNING_ESP);
+        glDisable(GL_TEXEL_CACHE_ESP);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_STENCIL_TEST);
+        glDisable(GL_TEXTURE_2D);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDepthFunc(GL_LESS);
+        glRasterWorkersESP(1);
+        glClearColor(0.f, 0.f, 0.f, 0.f);
+        glClearDepthf(1.f);
+        glClearStencil(0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    }
+    //two triangles covering the screen at depth z, scaled, rotated by angle degrees around the centre and moved to x, y
+    void drawQuad(GLfloat z, const GLfloat color[4], GLfloat angle = 0.f, GLfloat scale = 1.f, GLfloat x = 0.f, GLfloat y = 0.f)
+    {
+        const GLfloat vertices[] = { -scale, -scale, z, scale, -scale, z, scale, scale, z, -scale, -scale, z, scale, scale, z, -scale, scale, z };
+        const GLfloat texCoords[] = { 0.f, 0.f, 1.f, 0.f, 1.f, 1.f, 0.f, 0.f, 1.f, 1.f, 0.f, 1.f };
+        GLfloat colors[6 * 4];
+        for (uint8_t i = 0; i < 6; i++)
+            memcpy(colors + i * 4, color, sizeof(GLfloat) * 4);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        glTranslatef(x, y, 0.f);
+        glRotatef(angle, 0.f, 0.f, 1.f);
+        glVertexPointer(3, GL_FLOAT, 0, vertices);
+        glColorPointer(4, GL_FLOAT, 0, colors);
+        glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    //two triangles covering the screen with the given color at each corner, rotated by angle degrees around the centre
+    void drawGradient(const GLfloat corners[4][4], GLfloat angle)
+    {
+        const GLfloat vertices[] = { -2.f, -2.f, 0.f, 2.f, -2.f, 0.f, 2.f, 2.f, 0.f, -2.f, -2.f, 0.f, 2.f, 2.f, 0.f, -2.f, 2.f, 0.f };
+        const uint8_t corner[6] = { 0, 1, 2, 0, 2, 3 };
+        GLfloat colors[6 * 4];
+        for (uint8_t i = 0; i < 6; i++)
+            memcpy(colors + i * 4, corners[corner[i]], sizeof(GLfloat) * 4);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        glRotatef(angle, 0.f, 0.f, 1.f);
+        glVertexPointer(3, GL_FLOAT, 0, vertices);
+        glColorPointer(4, GL_FLOAT, 0, colors);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    GLuint checkerTexture(uint16_t size, bool tiled, GLenum filter)
+    {
+        std::vector<uint8_t> texels(size * size * 4);
+        for (uint16_t y = 0; y < size; y++)
+            for (uint16_t x = 0; x < size; x++)
+            {
+                uint8_t* texel = &texels[(y * size + x) * 4];
+                texel[0] = (x ^ y) * 16;
+                texel[1] = ((x >> 2) ^ (y >> 2)) & 1 ? 255 : 0;
+                texel[2] = x * 255 / size;
+                texel[3] = 255;
+            }
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_TILED_ESP, tiled);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+        return texture;
+    }
+    //overlapping rotated textured quads with depth, draws every kind of triangle the setup and kernels tell apart
+    void drawScene(GLuint texture)
+    {
+        const GLfloat white[4] = { 1.f, 1.f, 1.f, 1.f };
+        const GLfloat tint[4] = { 0.2f, 0.9f, 0.5f, 1.f };
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_TEXTURE_2D);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        drawQuad(0.5f, white, 0.f);
+        drawQuad(0.2f, tint, 30.f, 0.7f);
+        drawQuad(-0.1f, white, 75.f, 0.4f);
+        glDisable(GL_TEXTURE_2D);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        drawQuad(0.3f, tint, 10.f, 0.9f);
+    }
+
+    //a square image as uploaded, raw GL_RGB or GL_RGBA texels kept in storageType or a glCompressedTexImage2D image
+    struct Image
+    {
+        GLenum format;
+        std::vector<uint8_t> data;
+        GLenum storageType = GL_UNSIGNED_BYTE;
+    };
+    GLuint imageTexture(const Image& image, uint16_t size, GLenum filter)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_STORAGE_TYPE_ESP, image.storageType);
+        if (image.format == GL_RGB || image.format == GL_RGBA)
+            glTexImage2D(GL_TEXTURE_2D, 0, image.format, size, size, 0, image.format, GL_UNSIGNED_BYTE, image.data.data());
+        else
+            glCompressedTexImage2D(GL_TEXTURE_2D, 0, image.format, size, size, 0, image.data.size(), image.data.data());
+        return texture;
+    }
+    //bytes the texture of an image keeps, the compressed image itself or the texels in their storage type
+    uint32_t footprint(const Image& image, uint16_t size)
+    {
+        if (image.format != GL_RGB && image.format != GL_RGBA)
+            return image.data.size();
+        if (image.storageType != GL_UNSIGNED_BYTE)
+            return size * size * 2;
+        return size * size * (image.format == GL_RGB ? 3 : 4);
+    }
+    //random indices into a random palette of GL_PALETTE4_RGB8_OES or GL_PALETTE8_RGBA8_OES, and the entries they look up
+    void palettedImages(GLenum format, uint16_t size, Image& paletted, Image& decoded)
+    {
+        const bool palette4 = format == GL_PALETTE4_RGB8_OES;
+        const uint8_t channels = palette4 ? 3 : 4;
+        const uint32_t paletteSize = (palette4 ? 16 : 256) * channels;
+        paletted.format = format;
+        paletted.data.resize(paletteSize + (palette4 ? size * size / 2 : size * size));
+        uint32_t seed = format;
+        for (uint8_t& byte : paletted.data)
+        {
+            seed = seed * 1664525 + 1013904223;
+            byte = seed >> 24;
+        }
+        decoded.format = palette4 ? GL_RGB : GL_RGBA;
+        decoded.data.resize(size * size * channels);
+        const uint8_t* indices = paletted.data.data() + paletteSize;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(size * size); i++)
+        {
+            //4 bit indices two to a byte, the first texel in the high half
+            const uint8_t index = palette4 ? (i & 1 ? indices[i / 2] & 0xF : indices[i / 2] >> 4) : indices[i];
+            memcpy(&decoded.data[i * channels], &paletted.data[index * channels], channels);
+        }
+    }
+    //random ETC1 blocks and their texels decoded as the OES_compressed_ETC1_RGB8_texture spec reads the 64 bit block,
+    //differential blocks whose second base color would leave the 5 bit range are made individual ones
+    void etc1Images(uint16_t size, Image& etc1, Image& decoded)
+    {
+        static const int32_t modifiers[8][4] = { { 2, 8, -2, -8 }, { 5, 17, -5, -17 }, { 9, 29, -9, -29 }, { 13, 42, -13, -42 },
+            { 18, 60, -18, -60 }, { 24, 80, -24, -80 }, { 33, 106, -33, -106 }, { 47, 183, -47, -183 } };
+        const uint16_t blocks = size / 4;
+        etc1.format = GL_ETC1_RGB8_OES;
+        etc1.data.resize(blocks * blocks * 8);
+        decoded.format = GL_RGB;
+        decoded.data.resize(size * size * 3);
+        uint32_t seed = GL_ETC1_RGB8_OES;
+        for (uint32_t b = 0; b < static_cast<uint32_t>(blocks * blocks); b++)
+        {
+            uint8_t* block = &etc1.data[b * 8];
+            for (uint8_t i = 0; i < 8; i++)
+            {
+                seed = seed * 1664525 + 1013904223;
+                block[i] = seed >> 24;
+            }
+            for (uint8_t c = 0; c < 3; c++)
+            {
+                const int32_t base = block[c] >> 3, difference = (block[c] & 7) >= 4 ? (block[c] & 7) - 8 : block[c] & 7;
+                if (base + difference < 0 || base + difference > 31)
+                    block[3] &= ~2;
+            }
+            uint64_t word = 0;
+            for (uint8_t i = 0; i < 8; i++)
+                word = word << 8 | block[i];
+            const bool differential = word >> 33 & 1, flip = word >> 32 & 1;
+            int32_t base[2][3];
+            for (uint8_t c = 0; c < 3; c++)
+            {
+                if (differential)
+                {
+                    const int32_t first = word >> (59 - c * 8) & 0x1F, difference = word >> (56 - c * 8) & 7;
+                    const int32_t second = first + (difference >= 4 ? difference - 8 : difference);
+                    base[0][c] = first << 3 | first >> 2;
+                    base[1][c] = second << 3 | second >> 2;
+                }
+                else
+                {
+                    base[0][c] = (word >> (60 - c * 8) & 0xF) * 17;
+                    base[1][c] = (word >> (56 - c * 8) & 0xF) * 17;
+                }
+            }
+            const uint8_t table[2] = { static_cast<uint8_t>(word >> 37 & 7), static_cast<uint8_t>(word >> 34 & 7) };
+            for (uint8_t x = 0; x < 4; x++)
+                for (uint8_t y = 0; y < 4; y++)
+                {
+                    const uint8_t sub = flip ? y >= 2 : x >= 2;
+                    const uint8_t bit = x * 4 + y;
+                    const int32_t modifier = modifiers[table[sub]][(word >> (bit + 16) & 1) << 1 | (word >> bit & 1)];
+                    uint8_t* texel = &decoded.data[(((b / blocks) * 4 + y) * size + (b % blocks) * 4 + x) * 3];
+                    for (uint8_t c = 0; c < 3; c++)
+                        texel[c] = std::clamp(base[sub][c] + modifier, 0, 255);
+                }
+        }
+    }
+
+    bool checkGetCounts()
+    {
+        GLint values[32];
+        std::fill_n(values, 32, -1);
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+        glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, values);
+        if (count != 11 || values[count - 1] != GL_ETC1_RGB8_OES || values[count] != -1)
+            return false;
+        GLfloat floats[32];
+        std::fill_n(floats, 32, -1.f);
+        glGetFloatv(GL_COMPRESSED_TEXTURE_FORMATS, floats);
+        if (floats[count - 1] != GL_ETC1_RGB8_OES || floats[count] != -1.f)
+            return false;
+        //queries that are not implemented leave the result alone
+        glGetIntegerv(GL_FOG_MODE, values);
+        return values[0] == GL_PALETTE4_RGB8_OES;
+    }
+    //a stencil writing draw that pushes depth back has to leave the hierarchical z of its blocks unknown
+    bool checkHiZAfterStencilWrites()
+    {
+        const GLfloat red[4] = { 1.f, 0.f, 0.f, 1.f };
+        const GLfloat green[4] = { 0.f, 1.f, 0.f, 1.f };
+        const GLfloat blue[4] = { 0.f, 0.f, 1.f, 1.f };
+        resetState();
+        glEnable(GL_DEPTH_TEST);
+        //rotated, so they go through triangle setup rather than the screen aligned rectangle path, sampled away from
+        //the diagonal where whole blocks are covered by one triangle and tighten the hierarchical z
+        drawQuad(-0.6f, red, 20.f, 2.f);
+        glEnable(GL_STENCIL_TEST);
+        glStencilFunc(GL_ALWAYS, 1, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        glDepthFunc(GL_ALWAYS);
+        drawQuad(0.6f, green, 20.f, 2.f);
+        const uint16_t behind = pixel(width / 4, height * 3 / 4);
+        glDisable(GL_STENCIL_TEST);
+        glDepthFunc(GL_LESS);
+        drawQuad(0.f, blue, 20.f, 2.f);
+        return pixel(width / 4, height * 3 / 4) != behind;
+    }
+    //binned triangles resolved on several workers draw the same pixels as immediate ones
+    bool checkBinningMatchesImmediate()
+    {
+        resetState();
+        const GLuint texture = checkerTexture(64, false, GL_LINEAR);
+        drawScene(texture);
+        const std::vector<uint16_t> immediate = frame();
+        resetState();
+        glEnable(GL_TILE_BINNING_ESP);
+        glRasterWorkersESP(2);
+        drawScene(texture);
+        const bool same = frame() == immediate;
+        glDeleteTextures(1, &texture);
+        return same;
+    }
+    //the bins, tiles and hierarchical z of a small context without depth are not reused for a larger one with depth
+    bool checkBinningFollowsContext()
+    {
+        const GLfloat white[4] = { 1.f, 1.f, 1.f, 1.f };
+        Context* const main = context;
+        bool drawn = true;
+        {
+            Context small(&colorOnly);
+            createSurface(small, 64, 48);
+            makeCurrent(&small);
+            glEnable(GL_TILE_BINNING_ESP);
+            drawQuad(0.f, white, 20.f, 2.f);
+            glFinish();
+
+            Context large(&config);
+            createSurface(large, 480, 320);
+            makeCurrent(&large);
+            glEnable(GL_TILE_BINNING_ESP);
+            glEnable(GL_DEPTH_TEST);
+            glClearDepthf(1.f);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            drawQuad(0.f, white, 20.f, 2.f);
+            glFinish();
+            drawn = large.pixels.first[480 * 320 - 1] != 0 && large.depth.first[480 * 320 - 1] != 0xFFFF;
+            releaseContextState(&small);
+            releaseContextState(&large);
+        }
+        makeCurrent(main);
+        return drawn;
+    }
+    //a stencil buffer cleared in one context says nothing about the stencil buffer of another
+    bool checkStencilMaskFollowsContext()
+    {
+        const GLfloat white[4] = { 1.f, 1.f, 1.f, 1.f };
+        Context* const main = context;
+        resetState();
+        glClearStencil(1);
+        glClear(GL_STENCIL_BUFFER_BIT);
+        bool masked = true;
+        {
+            Context other(&config);
+            createSurface(other, width, height);
+            memset(other.pixels.first, 0, width * height * sizeof(uint16_t));
+            memset(other.stencil.first, 0, width * height);
+            makeCurrent(&other);
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_EQUAL, 1, 0xFF);
+            drawQuad(0.f, white, 20.f, 2.f);
+            glFinish();
+            masked = other.pixels.first[width * height / 2 + width / 2] == 0;
+            releaseContextState(&other);
+        }
+        makeCurrent(main);
+        return masked;
+    }
+    //the integer 565 blend of the span kernels against the float blendFragment of the generic path, which stencil writing
+    //draws take, for every blend mode pickBlend specializes, at most 1 LSB apart in every channel of color and alpha
+    bool checkBlendMatchesFloat()
+    {
+        const GLenum modes[][4] = {
+            { GL_ONE, GL_ZERO, GL_ONE, GL_ZERO },
+            { GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA },
+            { GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA },
+            { GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA },
+            { GL_ONE, GL_ONE, GL_ONE, GL_ONE },
+            { GL_SRC_ALPHA, GL_ONE, GL_ONE, GL_ONE },
+            { GL_DST_COLOR, GL_ZERO, GL_DST_COLOR, GL_ZERO },
+        };
+        const GLfloat backdrop[4][4] = { { 1.f, 0.f, 0.2f, 0.1f }, { 0.f, 1.f, 0.5f, 0.9f }, { 0.3f, 0.3f, 1.f, 0.5f }, { 1.f, 1.f, 1.f, 1.f } };
+        const GLfloat source[4][4] = { { 0.f, 0.4f, 1.f, 0.f }, { 1.f, 0.7f, 0.f, 1.f }, { 0.6f, 0.f, 0.3f, 0.3f }, { 0.1f, 1.f, 0.9f, 0.7f } };
+        const uint16_t size = 96;
+        Context* const main = context;
+        int32_t worst = 0;
+        {
+            Context surface(&withAlpha);
+            createSurface(surface, size, size);
+            makeCurrent(&surface);
+            for (const GLenum* mode : modes)
+            {
+                std::vector<uint16_t> color[2];
+                std::vector<uint8_t> alpha[2];
+                for (uint8_t generic = 0; generic < 2; generic++)
+                {
+                    glDisable(GL_BLEND);
+                    glDisable(GL_STENCIL_TEST);
+                    drawGradient(backdrop, 0.f);
+                    glEnable(GL_BLEND);
+                    glBlendFuncSeparateOES(mode[0], mode[1], mode[2], mode[3]);
+                    if (generic)
+                    {
+                        glEnable(GL_STENCIL_TEST);
+                        glStencilFunc(GL_ALWAYS, 1, 0xFF);
+                        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+                    }
+                    drawGradient(source, 35.f);
+                    glFinish();
+                    color[generic].assign(surface.pixels.first, surface.pixels.first + size * size);
+                    alpha[generic].assign(surface.alpha.first, surface.alpha.first + size * size);
+                }
+                for (uint32_t i = 0; i < size * size; i++)
+                {
+                    const uint16_t a = color[0][i] >> 8 | color[0][i] << 8, b = color[1][i] >> 8 | color[1][i] << 8;
+                    worst = std::max({ worst, std::abs((a >> 11) - (b >> 11)), std::abs((a >> 5 & 0x3F) - (b >> 5 & 0x3F)),
+                        std::abs((a & 0x1F) - (b & 0x1F)), std::abs(alpha[0][i] - alpha[1][i]) });
+                }
+            }
+            glDisable(GL_BLEND);
+            glDisable(GL_STENCIL_TEST);
+            releaseContextState(&surface);
+        }
+        makeCurrent(main);
+        return worst <= 1;
+    }
+    //tiled textures and the texel cache change where texels are fetched from, never which
+    bool checkTextureLayoutsMatch()
+    {
+        bool same = true;
+        for (GLenum filter : { GL_NEAREST, GL_LINEAR })
+        {
+            resetState();
+            const GLuint linear = checkerTexture(64, false, filter);
+            drawScene(linear);
+            const std::vector<uint16_t> reference = frame();
+            glDeleteTextures(1, &linear);
+
+            resetState();
+            const GLuint tiled = checkerTexture(64, true, filter);
+            drawScene(tiled);
+            same = same && frame() == reference;
+            resetState();
+            glEnable(GL_TEXEL_CACHE_ESP);
+            drawScene(tiled);
+            same = same && frame() == reference;
+            glDeleteTextures(1, &tiled);
+        }
+        return same;
+    }
+    //GL_UNSIGNED_BYTE uploads with rows padded by GL_UNPACK_ALIGNMENT that GL_TEXTURE_STORAGE_TYPE_ESP converts keep
+    //the texels an upload of the same texels already packed in that type keeps
+    bool checkUploadConversions()
+    {
+        const uint16_t uploadWidth = 63, uploadHeight = 17;
+        const struct
+        {
+            GLenum format, type;
+            GLint alignment;
+        } uploads[] = {
+            { GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 4 },
+            { GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, 8 },
+            { GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, 8 },
+        };
+        uint32_t seed = 1;
+        bool same = true;
+        for (const auto& upload : uploads)
+        {
+            const uint8_t texelBytes = upload.format == GL_RGB ? 3 : 4;
+            const uint32_t stride = (uploadWidth * texelBytes + upload.alignment - 1) / upload.alignment * upload.alignment;
+            std::vector<uint8_t> pixels(stride * uploadHeight);
+            std::vector<uint16_t> packed(uploadWidth * uploadHeight);
+            for (uint16_t j = 0; j < uploadHeight; j++)
+                for (uint16_t i = 0; i < uploadWidth; i++)
+                {
+                    uint8_t* texel = &pixels[j * stride + i * texelBytes];
+                    for (uint8_t c = 0; c < texelBytes; c++)
+                    {
+                        seed = seed * 1664525 + 1013904223;
+                        texel[c] = seed >> 24;
+                    }
+                    uint16_t& value = packed[j * uploadWidth + i];
+                    if (upload.type == GL_UNSIGNED_SHORT_5_6_5)
+                        value = (texel[0] >> 3) << 11 | (texel[1] >> 2) << 5 | texel[2] >> 3;
+                    else if (upload.type == GL_UNSIGNED_SHORT_4_4_4_4)
+                        value = (texel[0] >> 4) << 12 | (texel[1] >> 4) << 8 | (texel[2] >> 4) << 4 | texel[3] >> 4;
+                    else
+                        value = (texel[0] >> 3) << 11 | (texel[1] >> 3) << 6 | (texel[2] >> 3) << 1 | texel[3] >> 7;
+                }
+            GLuint textures[2];
+            glGenTextures(2, textures);
+            glBindTexture(GL_TEXTURE_2D, textures[0]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_STORAGE_TYPE_ESP, upload.type);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, upload.alignment);
+            glTexImage2D(GL_TEXTURE_2D, 0, upload.format, uploadWidth, uploadHeight, 0, upload.format, GL_UNSIGNED_BYTE, pixels.data());
+            glBindTexture(GL_TEXTURE_2D, textures[1]);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+            glTexImage2D(GL_TEXTURE_2D, 0, upload.format, uploadWidth, uploadHeight, 0, upload.format, upload.type, packed.data());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            same = same && glGetError() == GL_NO_ERROR &&
+                memcmp(context->glTextures[textures[0]].data, context->glTextures[textures[1]].data, packed.size() * sizeof(uint16_t)) == 0;
+            glDeleteTextures(2, textures);
+        }
+        return same;
+    }
+    //paletted and ETC1 textures draw what the texels they decode to draw uploaded as plain GL_RGB or GL_RGBA
+    bool checkCompressedMatchesDecoded()
+    {
+        const uint16_t size = 64;
+        Image compressed[3], decoded[3];
+        palettedImages(GL_PALETTE4_RGB8_OES, size, compressed[0], decoded[0]);
+        palettedImages(GL_PALETTE8_RGBA8_OES, size, compressed[1], decoded[1]);
+        etc1Images(size, compressed[2], decoded[2]);
+        bool same = true;
+        for (uint8_t i = 0; i < 3; i++)
+            for (GLenum filter : { GL_NEAREST, GL_LINEAR })
+            {
+                resetState();
+                const GLuint reference = imageTexture(decoded[i], size, filter);
+                drawScene(reference);
+                const std::vector<uint16_t> expected = frame();
+                glDeleteTextures(1, &reference);
+
+                resetState();
+                const GLuint texture = imageTexture(compressed[i], size, filter);
+                drawScene(texture);
+                same = same && glGetError() == GL_NO_ERROR && frame() == expected;
+                glDeleteTextures(1, &texture);
+            }
+        return same;
+    }
+
+    //nanoseconds per fragment of a full screen rotated textured quad, the quad is scaled to cover the whole screen
+    double textureFillRate(GLuint texture, bool texelCache)
+    {
+        const GLfloat white[4] = { 1.f, 1.f, 1.f, 1.f };
+        const uint16_t frames = 100;
+        resetState();
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (texelCache)
+            glEnable(GL_TEXEL_CACHE_ESP);
+        glEnable(GL_TEXTURE_2D);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        const auto start = std::chrono::steady_clock::now();
+        for (uint16_t i = 0; i < frames; i++)
+            drawQuad(0.f, white, 30.f + i * 0.1f, 2.f);
+        glFinish();
+        const std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+        return time.count() / (static_cast<double>(frames) * width * height);
+    }
+    double fillRate(GLenum filter, bool tiled, bool texelCache)
+    {
+        const GLuint texture = checkerTexture(256, tiled, filter);
+        const double rate = textureFillRate(texture, texelCache);
+        glDeleteTextures(1, &texture);
+        return rate;
+    }
+    double fillRate(const Image& image, uint16_t size, GLenum filter)
+    {
+        const GLuint texture = imageTexture(image, size, filter);
+        const double rate = textureFillRate(texture, false);
+        glDeleteTextures(1, &texture);
+        return rate;
+    }
+    //nanoseconds per fragment of small textured sprites at every angle, a rotated sprite walks its texture diagonally,
+    //which is what the tiled layout and the texel cache are for
+    double spriteRate(GLenum filter, bool tiled, bool texelCache)
+    {
+        const GLfloat white[4] = { 1.f, 1.f, 1.f, 1.f };
+        const uint16_t sprites = 2000;
+        //half the edge of a sprite, one sprite is a sixteenth of the screen and stays on it at any angle
+        const GLfloat scale = 0.25f;
+        resetState();
+        const GLuint texture = checkerTexture(128, tiled, filter);
+        if (texelCache)
+            glEnable(GL_TEXEL_CACHE_ESP);
+        glEnable(GL_TEXTURE_2D);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        uint32_t seed = 1;
+        auto random = [&seed]() { seed = seed * 1664525 + 1013904223; return (seed >> 8) / 8388608.f - 1.f; };
+        const auto start = std::chrono::steady_clock::now();
+        for (uint16_t i = 0; i < sprites; i++)
+            drawQuad(0.f, white, i * 7.f, scale, random() * 0.6f, random() * 0.6f);
+        glFinish();
+        const std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+        glDeleteTextures(1, &texture);
+        return time.count() / (sprites * scale * scale * width * height);
+    }
+
+    //megabytes per second of texels glTexImage2D takes in, format texels in rows padded to alignment kept in storageType,
+    //padding not counted
+    double uploadRate(GLenum format, GLenum storageType, uint16_t uploadWidth, uint16_t uploadHeight, GLint alignment)
+    {
+        const uint8_t texelBytes = format == GL_RGB ? 3 : 4;
+        const uint32_t stride = (uploadWidth * texelBytes + alignment - 1) / alignment * alignment;
+        std::vector<uint8_t> pixels(stride * uploadHeight);
+        for (uint32_t i = 0; i < pixels.size(); i++)
+            pixels[i] = i * 7;
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_STORAGE_TYPE_ESP, storageType);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        const uint16_t uploads = 100;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint16_t i = 0; i < uploads; i++)
+            glTexImage2D(GL_TEXTURE_2D, 0, format, uploadWidth, uploadHeight, 0, format, GL_UNSIGNED_BYTE, pixels.data());
+        const std::chrono::duration<double, std::micro> time = std::chrono::steady_clock::now() - start;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glDeleteTextures(1, &texture);
+        return static_cast<double>(uploads) * uploadWidth * uploadHeight * texelBytes / time.count();
+    }
+    //the same for the loop uploads went through before, one memcpy of a texel at a time into the row major level
+    double perTexelUploadRate(uint8_t texelBytes, uint16_t uploadWidth, uint16_t uploadHeight)
+    {
+        std::vector<uint8_t> pixels(uploadWidth * uploadHeight * texelBytes), level(pixels.size());
+        for (uint32_t i = 0; i < pixels.size(); i++)
+            pixels[i] = i * 7;
+        const uint16_t uploads = 100;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint16_t n = 0; n < uploads; n++)
+        {
+            const uint8_t* src = pixels.data();
+            for (uint16_t j = 0; j < uploadHeight; j++)
+                for (uint16_t i = 0; i < uploadWidth; i++, src += texelBytes)
+                    memcpy(&level[(j * uploadWidth + i) * texelBytes], src, texelBytes);
+        }
+        const std::chrono::duration<double, std::micro> time = std::chrono::steady_clock::now() - start;
+        //keeps the copies from being optimized away
+        volatile uint8_t sink = level[level.size() / 2];
+        (void)sink;
+        return static_cast<double>(uploads) * pixels.size() / time.count();
+    }
+
+    //the coverage loops of rasterizeTriangle without any shading, the float edge functions it used to evaluate at every
+    //pixel of the bounding box and the fixed point ones it steps now, both count the covered pixels
+    struct Triangle
+    {
+        float x[3], y[3];
+    };
+    uint32_t perPixelCoverage(const Triangle& tri)
+    {
+        auto edge = [](float ax, float ay, float bx, float by, float px, float py) { return (px - ax) * (by - ay) - (py - ay) * (bx - ax); };
+        const float minX = std::clamp(std::min({ tri.x[0], tri.x[1], tri.x[2] }), -1.f, 1.f);
+        const float maxX = std::clamp(std::max({ tri.x[0], tri.x[1], tri.x[2] }), -1.f, 1.f);
+        const float minY = std::clamp(std::min({ tri.y[0], tri.y[1], tri.y[2] }), -1.f, 1.f);
+        const float maxY = std::clamp(std::max({ tri.y[0], tri.y[1], tri.y[2] }), -1.f, 1.f);
+        uint32_t covered = 0;
+        for (int32_t iy = floorf((0.5f + 0.5f * minY) * height); iy < ceilf((0.5f + 0.5f * maxY) * height); iy++)
+        {
+            const float py = -1.f + iy * 2.f / height;
+            for (int32_t ix = floorf((0.5f + 0.5f * minX) * width); ix < ceilf((0.5f + 0.5f * maxX) * width); ix++)
+            {
+                const float px = -1.f + ix * 2.f / width;
+                const float w0 = edge(tri.x[1], tri.y[1], tri.x[2], tri.y[2], px, py);
+                const float w1 = edge(tri.x[2], tri.y[2], tri.x[0], tri.y[0], px, py);
+                const float w2 = edge(tri.x[0], tri.y[0], tri.x[1], tri.y[1], px, py);
+                if ((w0 >= 0.f && w1 >= 0.f && w2 >= 0.f) || (w0 <= 0.f && w1 <= 0.f && w2 <= 0.f))
+                    covered++;
+            }
+        }
+        return covered;
+    }
+    uint32_t steppedCoverage(const Triangle& tri)
+    {
+        int32_t x[3], y[3];
+        for (uint8_t i = 0; i < 3; i++)
+        {
+            x[i] = lroundf((tri.x[i] * 0.5f + 0.5f) * width * 16.f);
+            y[i] = lroundf((0.5f - tri.y[i] * 0.5f) * height * 16.f);
+        }
+        if (static_cast<int64_t>(x[1] - x[0]) * (y[2] - y[0]) - static_cast<int64_t>(y[1] - y[0]) * (x[2] - x[0]) < 0)
+        {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+        }
+        const int32_t minX = std::max(0, std::min({ x[0], x[1], x[2] }) >> 4);
+        const int32_t maxX = std::min(width - 1, std::max({ x[0], x[1], x[2] }) >> 4);
+        const int32_t minY = std::max(0, std::min({ y[0], y[1], y[2] }) >> 4);
+        const int32_t maxY = std::min(height - 1, std::max({ y[0], y[1], y[2] }) >> 4);
+        int32_t value[3], stepX[3], stepY[3];
+        for (uint8_t i = 0; i < 3; i++)
+        {
+            const uint8_t a = (i + 1) % 3, b = (i + 2) % 3;
+            const int32_t A = y[a] - y[b], B = x[b] - x[a];
+            value[i] = A * ((minX << 4) + 8 - x[a]) + B * ((minY << 4) + 8 - y[a]) - !(A > 0 || (A == 0 && B > 0));
+            stepX[i] = A * 16;
+            stepY[i] = B * 16;
+        }
+        uint32_t covered = 0;
+        for (int32_t iy = minY; iy <= maxY; iy++)
+        {
+            int32_t w0 = value[0], w1 = value[1], w2 = value[2];
+            for (int32_t ix = minX; ix <= maxX; ix++, w0 += stepX[0], w1 += stepX[1], w2 += stepX[2])
+                covered += (w0 | w1 | w2) >= 0;
+            value[0] += stepY[0];
+            value[1] += stepY[1];
+            value[2] += stepY[2];
+        }
+        return covered;
+    }
+    //nanoseconds per covered pixel over a fixed set of random triangles of every size
+    double coverageRate(uint32_t (*coverage)(const Triangle&), uint32_t& covered)
+    {
+        std::vector<Triangle> triangles(256);
+        uint32_t seed = 1;
+        auto random = [&seed]() { seed = seed * 1664525 + 1013904223; return (seed >> 8) / 8388608.f - 1.f; };
+        for (Triangle& tri : triangles)
+        {
+            const float cx = random(), cy = random(), size = 0.05f + (random() + 1.f) * 0.5f;
+            for (uint8_t i = 0; i < 3; i++)
+            {
+                tri.x[i] = std::clamp(cx + random() * size, -1.f, 1.f);
+                tri.y[i] = std::clamp(cy + random() * size, -1.f, 1.f);
+            }
+        }
+        const uint16_t rounds = 50;
+        covered = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint16_t i = 0; i < rounds; i++)
+            for (const Triangle& tri : triangles)
+                covered += coverage(tri);
+        const std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+        return time.count() / covered;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Context host(&config);
+    createSurface(host, width, height);
+    context = &host;
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    const struct
+    {
+        const char* name;
+        bool (*run)();
+    } checks[] = {
+        { "glGet value counts", checkGetCounts },
+        { "hierarchical z after stencil writes", checkHiZAfterStencilWrites },
+        { "tile binning matches immediate drawing", checkBinningMatchesImmediate },
+        { "tile binning follows the current context", checkBinningFollowsContext },
+        { "stencil mask follows the current context", checkStencilMaskFollowsContext },
+        { "tiled and cached textures match row major", checkTextureLayoutsMatch },
+        { "integer blending matches the float path", checkBlendMatchesFloat },
+        { "paletted and ETC1 textures match their decoded texels", checkCompressedMatchesDecoded },
+        { "converted uploads with padded rows match packed ones", checkUploadConversions },
+    };
+    int failures = 0;
+    for (const auto& check : checks)
+    {
+        const bool passed = check.run();
+        printf("%s %s\n", passed ? "pass" : "FAIL", check.name);
+        failures += !passed;
+    }
+    if (argc > 1 && strcmp(argv[1], "--check") == 0)
+        return failures ? 1 : 0;
+
+    printf("GL_NEAREST                  %6.2f ns/fragment\n", fillRate(GL_NEAREST, false, false));
+    printf("GL_LINEAR                   %6.2f ns/fragment\n", fillRate(GL_LINEAR, false, false));
+    printf("GL_LINEAR tiled             %6.2f ns/fragment\n", fillRate(GL_LINEAR, true, false));
+    printf("GL_LINEAR tiled texel cache %6.2f ns/fragment\n", fillRate(GL_LINEAR, true, true));
+    for (GLenum filter : { GL_NEAREST, GL_LINEAR })
+    {
+        const char* name = filter == GL_NEAREST ? "GL_NEAREST" : "GL_LINEAR ";
+        printf("%s sprites row major      %6.2f ns/fragment\n", name, spriteRate(filter, false, false));
+        printf("%s sprites tiled          %6.2f ns/fragment\n", name, spriteRate(filter, true, false));
+        printf("%s sprites row major cache %5.2f ns/fragment\n", name, spriteRate(filter, false, true));
+        printf("%s sprites tiled cache    %6.2f ns/fragment\n", name, spriteRate(filter, true, true));
+    }
+    {
+        //the same texels as GL_RGBA or GL_RGB, stored as they are or as 565, against the compressed images they came from
+        const uint16_t size = 256;
+        Image palette4, palette8, etc1, rgb8, rgba8, rgb565;
+        palettedImages(GL_PALETTE4_RGB8_OES, size, palette4, rgb8);
+        palettedImages(GL_PALETTE8_RGBA8_OES, size, palette8, rgba8);
+        etc1Images(size, etc1, rgb565);
+        rgb565.storageType = GL_UNSIGNED_SHORT_5_6_5;
+        const struct
+        {
+            const char* name;
+            const Image& image;
+        } formats[] = {
+            { "GL_RGBA", rgba8 }, { "GL_RGB", rgb8 }, { "GL_RGB as 565", rgb565 },
+            { "GL_PALETTE8_RGBA8_OES", palette8 }, { "GL_PALETTE4_RGB8_OES", palette4 }, { "GL_ETC1_RGB8_OES", etc1 },
+        };
+        for (const auto& format : formats)
+            printf("%-21s %6u bytes, GL_NEAREST %6.2f, GL_LINEAR %6.2f ns/fragment\n", format.name, footprint(format.image, size),
+                fillRate(format.image, size, GL_NEAREST), fillRate(format.image, size, GL_LINEAR));
+    }
+    //rows of 255 texels are padded by GL_UNPACK_ALIGNMENT, 256 texels of GL_RGBA need none
+    printf("per texel copy GL_RGBA    256x256           %7.1f MB/s\n", perTexelUploadRate(4, 256, 256));
+    printf("per texel copy GL_RGB     255x255           %7.1f MB/s\n", perTexelUploadRate(3, 255, 255));
+    printf("GL_RGBA                   256x256 aligned 4 %7.1f MB/s\n", uploadRate(GL_RGBA, GL_UNSIGNED_BYTE, 256, 256, 4));
+    printf("GL_RGB                    255x255 aligned 4 %7.1f MB/s\n", uploadRate(GL_RGB, GL_UNSIGNED_BYTE, 255, 255, 4));
+    printf("GL_RGB to 565             255x255 aligned 4 %7.1f MB/s\n", uploadRate(GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 255, 255, 4));
+    printf("GL_RGBA to 4444           255x255 aligned 8 %7.1f MB/s\n", uploadRate(GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, 255, 255, 8));
+    printf("GL_RGBA to 5551           255x255 aligned 8 %7.1f MB/s\n", uploadRate(GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, 255, 255, 8));
+    uint32_t covered;
+    printf("per pixel float edges        %6.2f ns/covered pixel", coverageRate(perPixelCoverage, covered));
+    printf(", %u pixels\n", covered);
+    printf("stepped fixed point edges    %6.2f ns/covered pixel", coverageRate(steppedCoverage, covered));
+    printf(", %u pixels\n", covered);
+    return failures ? 1 : 0;
+}